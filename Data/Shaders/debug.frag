@@ -0,0 +1,7 @@
+#version 410 core
+in vec4 color;
+out vec4 fragColor;
+
+void main(){
+    fragColor = color;
+}
\ No newline at end of file
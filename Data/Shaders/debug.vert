@@ -1,8 +1,12 @@
 #version 410 core
 
 layout (location = 0) in vec3 vPosition;
+layout (location = 1) in vec4 vColor;
 uniform mat4 MVP;
- 
+
+out vec4 color;
+
 void main() {
+    color = vColor;
     gl_Position = MVP * vec4(vPosition, 1.0);
 }
\ No newline at end of file
@@ -1,27 +1,37 @@
 #version 410
 
+// Variants: TEXTURED samples texture0, meshes without a texture use a constant color
+
 in vec2 TexCoord0;
 in vec3 Normal0;
 in vec3 WorldPos0;
 
-struct DirectionalLight
-{
-    vec3 color;
-    vec3 direction;
-};
-
 out vec4 FragColor;
+
+#ifdef TEXTURED
 uniform sampler2D texture0;
+#endif
 
-uniform vec3 ambient;
-uniform DirectionalLight directionalLight;
+// Needs to match uniforms::FrameBlock in FrameUniforms.h
+layout(std140) uniform Frame
+{
+    mat4 ViewProjection;
+    vec4 CameraPosition;
+    vec4 Ambient;
+    vec4 LightColor;
+    vec4 LightDirection;
+};
 
 void main()
 {
+#ifdef TEXTURED
     vec3 color = texture(texture0, TexCoord0.xy).rgb;
+#else
+    vec3 color = vec3(0.8);
+#endif
     vec3 normal = normalize(Normal0);
-    float NdL = max(0.15, dot(normal, directionalLight.direction));
-    vec3 lighting = color * NdL + ambient * color;
+    float NdL = max(0.15, dot(normal, LightDirection.xyz));
+    vec3 lighting = color * NdL + Ambient.rgb * color;
 
     FragColor = vec4(lighting, 1.0);
 }
\ No newline at end of file
@@ -1,23 +1,69 @@
 #version 410
 
+// Variants: SKINNED transforms the vertices with the bone palette
+
 layout(location = 0) in vec3 Position;
 layout(location = 1) in vec2 TexCoord;
 layout(location = 2) in vec3 Normal;
 
+#ifdef SKINNED
+// Needs to match MAX_BONES in Model.h
+#define MAX_BONES 256
+
+layout(location = 3) in uvec4 BoneIds;
+layout(location = 4) in vec4 BoneWeights;
+#endif
+
 out vec2 TexCoord0;
 out vec3 Normal0;
 out vec3 WorldPos0;
 
-uniform mat4 MVP;
-uniform mat4 gWorld;
+// Needs to match uniforms::FrameBlock and uniforms::DrawBlock in FrameUniforms.h
+layout(std140) uniform Frame
+{
+	mat4 ViewProjection;
+	vec4 CameraPosition;
+	vec4 Ambient;
+	vec4 LightColor;
+	vec4 LightDirection;
+};
+
+layout(std140) uniform Draw
+{
+	mat4 World;
+	mat4 NormalMatrix;
+};
+
+#ifdef SKINNED
+// Model-space bone matrices including their offset matrices, uploaded once per frame
+layout(std140) uniform BonePalette
+{
+	mat4 Bones[MAX_BONES];
+};
+#endif
 
 void main()
 {
+#ifdef SKINNED
+	// Vertices without influences have all weights set to 0 and keep their rest pose
+	float Total = BoneWeights.x + BoneWeights.y + BoneWeights.z + BoneWeights.w;
+	mat4 Skin = mat4(1.0 - Total);
+	Skin += Bones[BoneIds.x] * BoneWeights.x;
+	Skin += Bones[BoneIds.y] * BoneWeights.y;
+	Skin += Bones[BoneIds.z] * BoneWeights.z;
+	Skin += Bones[BoneIds.w] * BoneWeights.w;
+
+	vec4 PosL = Skin * vec4(Position, 1.0);
+	vec3 NormalL = mat3(Skin) * Normal;
+#else
 	vec4 PosL = vec4(Position, 1.0);
-	gl_Position = MVP * PosL;
+	vec3 NormalL = Normal;
+#endif
+
+	vec4 WorldPos = World * PosL;
+	gl_Position = ViewProjection * WorldPos;
 	TexCoord0 = TexCoord;
 
-	vec4 NormalL = vec4(Normal, 0.0);
-	Normal0 = (gWorld * vec4(NormalL.xyz, 0.0)).xyz;
-	WorldPos0 = (gWorld * PosL).xyz;
+	Normal0 = (NormalMatrix * vec4(NormalL, 0.0)).xyz;
+	WorldPos0 = WorldPos.xyz;
 }
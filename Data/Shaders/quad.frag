@@ -37,9 +37,6 @@ void main()
 		tc = vec2((x - 0.666666667) * 3.0, y);
 	}
 
-	float scaleFactor = 0.31;
-	float scaleOffset = (1.0 - scaleFactor) * 0.5;
-
 	switch(tex)
 	{
 	case(1):
@@ -49,7 +46,8 @@ void main()
 		pixel = texture(t2, vec2(tc.x, tc.y)).rgb;
 		break;
 	case(3):
-		pixel = texture(t3, vec2(tc.x * scaleFactor + scaleOffset, tc.y)).rgb;
+		// The video texture only holds the slice shown in this panel
+		pixel = texture(t3, vec2(tc.x, tc.y)).rgb;
 		break;
 	default:
 		pixel = vec3(1.0, 0.0, 0.0);
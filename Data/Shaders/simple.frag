@@ -1,6 +0,0 @@
-#version 410 core
-out vec4 color;
-
-void main(){
-    color = vec4(1, 1, 1, 1);
-}
\ No newline at end of file
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "utils/Timer.h"
+
+#include <algorithm>
+#include <cstdio>
+
+/**
+ * Helpers for the micro benchmarks. Each benchmark prints one line per case and returns a
+ * non-zero exit code if the compared implementations disagree.
+ */
+namespace bench
+{
+
+/**
+ * Runs body Repeats times and returns the fastest run in milliseconds
+ */
+template <typename Body>
+double bestOfMs(int Repeats, Body body)
+{
+	double Best = 1e30;
+	for (int r = 0; r < Repeats; r++)
+	{
+		utils::Timer Timer;
+		body();
+		Best = std::min(Best, static_cast<double>(Timer.elapsedMs()));
+	}
+	return Best;
+}
+
+/**
+ * Keeps results alive, so the compiler cannot drop the benchmarked work
+ */
+template <typename T>
+void keep(const T &Value)
+{
+	static volatile T Sink;
+	Sink = Value;
+}
+
+} // namespace bench
@@ -0,0 +1,73 @@
+#include "BenchUtils.h"
+
+#include "KeyframeSearch.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+// Frames sampled per run, at 60 frames per second over the whole clip
+constexpr unsigned int NUM_FRAMES = 100000;
+constexpr int REPEATS = 5;
+
+// Search used before the cursor, scans the keys from the start on every lookup
+static unsigned int findKeyframeLinear(float AnimationTime, const std::vector<float> &Times)
+{
+	for (unsigned int i = 0; i + 2 < Times.size(); i++)
+	{
+		if (AnimationTime < Times[i + 1])
+			return i;
+	}
+	return static_cast<unsigned int>(Times.size() - 2);
+}
+
+/*
+ * Times playback at a fixed step, which the cursor answers from the cached interval, and
+ * random seeks, which fall back to the binary search. Returns false if the results differ.
+ */
+static bool benchmark(unsigned int NumKeys)
+{
+	std::vector<float> Times(NumKeys);
+	for (unsigned int i = 0; i < NumKeys; i++)
+		Times[i] = i / 30.0f;
+	const auto keyTime = [&Times](unsigned int i) { return Times[i]; };
+
+	std::vector<float> Playback(NUM_FRAMES), Seeks(NUM_FRAMES);
+	std::mt19937 Random(NumKeys);
+	std::uniform_real_distribution<float> Time(0.0f, Times.back());
+	for (unsigned int f = 0; f < NUM_FRAMES; f++)
+	{
+		Playback[f] = std::fmod(f / 60.0f, Times.back());
+		Seeks[f] = Time(Random);
+	}
+
+	bool Match = true;
+	for (const std::vector<float> *Samples : {&Playback, &Seeks})
+	{
+		std::vector<unsigned int> Linear(NUM_FRAMES), Cursor(NUM_FRAMES);
+		const double LinearMs = bench::bestOfMs(REPEATS, [&]() {
+			for (unsigned int f = 0; f < NUM_FRAMES; f++)
+				Linear[f] = findKeyframeLinear((*Samples)[f], Times);
+		});
+		const double CursorMs = bench::bestOfMs(REPEATS, [&]() {
+			unsigned int Position = 0;
+			for (unsigned int f = 0; f < NUM_FRAMES; f++)
+				Cursor[f] = findKeyframe((*Samples)[f], NumKeys, Position, keyTime);
+		});
+		bench::keep(Linear.back() + Cursor.back());
+
+		const bool Same = Linear == Cursor;
+		Match = Match && Same;
+		std::printf("%5u keys, %-8s linear %8.2f ns, cursor %6.2f ns, %6.1fx%s\n", NumKeys, Samples == &Playback ? "playback" : "seek",
+					LinearMs * 1e6 / NUM_FRAMES, CursorMs * 1e6 / NUM_FRAMES, LinearMs / CursorMs, Same ? "" : "  MISMATCH");
+	}
+	return Match;
+}
+
+int main()
+{
+	bool Match = true;
+	for (const unsigned int NumKeys : {8u, 64u, 512u, 4096u})
+		Match = benchmark(NumKeys) && Match;
+	return Match ? 0 : 1;
+}
@@ -0,0 +1,54 @@
+#include "BenchUtils.h"
+
+#include "PixelConvert.h"
+
+#include <random>
+#include <vector>
+
+// A 4K texture, rows are padded like FreeImage scanlines
+constexpr unsigned int WIDTH = 4096;
+constexpr unsigned int HEIGHT = 2048;
+constexpr size_t PITCH = WIDTH * 4 + 64;
+constexpr int REPEATS = 10;
+
+// Per-pixel conversion like the loop used before, reading every channel separately
+static void bgraToRgbaPerPixel(const unsigned char *Src, size_t SrcPitch, unsigned int *Dst, unsigned int Width, unsigned int Height)
+{
+	for (unsigned int y = 0; y < Height; y++)
+	{
+		for (unsigned int x = 0; x < Width; x++)
+		{
+			const unsigned char *Pixel = Src + SrcPitch * y + 4 * x;
+			const unsigned int Blue = Pixel[0], Green = Pixel[1], Red = Pixel[2], Alpha = Pixel[3];
+			Dst[x + static_cast<size_t>(y) * Width] = Red | (Green << 8) | (Blue << 16) | (Alpha << 24);
+		}
+	}
+}
+
+static double megabytesPerSecond(double Ms)
+{
+	return static_cast<double>(WIDTH) * HEIGHT * 4 / (1024.0 * 1024.0) / (Ms / 1000.0);
+}
+
+int main()
+{
+	std::vector<unsigned char> Source(PITCH * HEIGHT);
+	std::mt19937 Random(3);
+	for (unsigned char &Byte : Source)
+		Byte = static_cast<unsigned char>(Random());
+
+	std::vector<unsigned int> Reference(static_cast<size_t>(WIDTH) * HEIGHT), Converted(Reference.size()), Copied(Reference.size());
+
+	const double PerPixelMs = bench::bestOfMs(REPEATS, [&]() { bgraToRgbaPerPixel(Source.data(), PITCH, Reference.data(), WIDTH, HEIGHT); });
+	const double SwizzleMs = bench::bestOfMs(REPEATS, [&]() { pixels::bgraToRgba(Source.data(), PITCH, Converted.data(), WIDTH, HEIGHT); });
+	const double CopyMs = bench::bestOfMs(REPEATS, [&]() { pixels::copyRows(Source.data(), PITCH, Copied.data(), WIDTH, HEIGHT); });
+	bench::keep(Reference.back() ^ Converted.back() ^ Copied.back());
+
+	const bool Match = Converted == Reference;
+	std::printf("%ux%u pixels\n", WIDTH, HEIGHT);
+	std::printf("%-10s %8.0f MB/s\n", "per pixel", megabytesPerSecond(PerPixelMs));
+	std::printf("%-10s %8.0f MB/s, %5.1fx%s\n", "bgraToRgba", megabytesPerSecond(SwizzleMs), PerPixelMs / SwizzleMs, Match ? "" : "  MISMATCH");
+	std::printf("%-10s %8.0f MB/s\n", "copyRows", megabytesPerSecond(CopyMs));
+
+	return Match ? 0 : 1;
+}
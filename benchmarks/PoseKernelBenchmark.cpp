@@ -0,0 +1,117 @@
+#include "BenchUtils.h"
+
+#include "PoseKernel.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <vector>
+
+// Bones of a typical character and number of poses composed per run
+constexpr unsigned int NUM_BONES = 67;
+constexpr unsigned int NUM_POSES = 20000;
+constexpr int REPEATS = 5;
+// Largest accepted difference of a matrix element, relative to the largest element of the glm matrix
+constexpr float TOLERANCE = 1e-5f;
+
+struct BoneTransform
+{
+	glm::vec3 Translation;
+	glm::quat Rotation;
+	glm::vec3 Scale;
+};
+
+// Per-bone composition used before the kernels, kept as the reference
+static void composeGlm(const std::vector<BoneTransform> &Bones, glm::mat4 *Out)
+{
+	for (size_t i = 0; i < Bones.size(); i++)
+	{
+		const glm::mat4 S = glm::scale(glm::mat4(1), Bones[i].Scale);
+		const glm::mat4 R = glm::mat4_cast(Bones[i].Rotation);
+		const glm::mat4 T = glm::translate(glm::mat4(1), Bones[i].Translation);
+		Out[i] = T * R * S;
+	}
+}
+
+static float maxRelativeError(const std::vector<glm::mat4> &Result, const std::vector<glm::mat4> &Reference)
+{
+	float Error = 0.0f;
+	for (size_t i = 0; i < Reference.size(); i++)
+	{
+		float Magnitude = 1.0f;
+		for (int c = 0; c < 4; c++)
+			for (int r = 0; r < 4; r++)
+				Magnitude = std::max(Magnitude, std::abs(Reference[i][c][r]));
+		for (int c = 0; c < 4; c++)
+			for (int r = 0; r < 4; r++)
+				Error = std::max(Error, std::abs(Result[i][c][r] - Reference[i][c][r]) / Magnitude);
+	}
+	return Error;
+}
+
+int main()
+{
+	std::mt19937 Random(5);
+	std::uniform_real_distribution<float> Value(-1.0f, 1.0f);
+
+	std::vector<BoneTransform> Bones(NUM_BONES);
+	PoseStreams Pose;
+	Pose.resize(NUM_BONES);
+	for (unsigned int i = 0; i < NUM_BONES; i++)
+	{
+		BoneTransform &Bone = Bones[i];
+		Bone.Translation = glm::vec3(Value(Random), Value(Random), Value(Random)) * 50.0f;
+		Bone.Rotation = glm::normalize(glm::quat(Value(Random), Value(Random), Value(Random), Value(Random)));
+		Bone.Scale = glm::vec3(1.0f) + 0.2f * glm::vec3(Value(Random), Value(Random), Value(Random));
+
+		Pose.setTranslation(i, Bone.Translation);
+		Pose.setRotation(i, Bone.Rotation.x, Bone.Rotation.y, Bone.Rotation.z, Bone.Rotation.w);
+		Pose.setScale(i, Bone.Scale);
+	}
+
+	std::vector<unsigned int> Targets(NUM_BONES);
+	std::iota(Targets.begin(), Targets.end(), 0u);
+
+	std::vector<glm::mat4> Reference(NUM_BONES);
+	const double GlmMs = bench::bestOfMs(REPEATS, [&]() {
+		for (unsigned int p = 0; p < NUM_POSES; p++)
+		{
+			composeGlm(Bones, Reference.data());
+			bench::keep(Reference[p % NUM_BONES][3][0]);
+		}
+	});
+	std::printf("%-8s %8.1f ns per pose\n", "glm", GlmMs * 1e6 / NUM_POSES);
+
+	bool Match = true;
+	const pose::Kernel Default = pose::getKernel();
+	for (const pose::Kernel Kernel : {pose::Kernel::Scalar, pose::Kernel::SSE, pose::Kernel::AVX2})
+	{
+		pose::setKernel(Kernel);
+		if (pose::getKernel() != Kernel)
+		{
+			std::printf("%-8s not supported by this CPU\n", pose::getKernelName(Kernel));
+			continue;
+		}
+
+		std::vector<glm::mat4> Result(NUM_BONES);
+		const double KernelMs = bench::bestOfMs(REPEATS, [&]() {
+			for (unsigned int p = 0; p < NUM_POSES; p++)
+			{
+				pose::composeMatrices(Pose, Targets.data(), Result.data());
+				bench::keep(Result[p % NUM_BONES][3][0]);
+			}
+		});
+
+		const float Error = maxRelativeError(Result, Reference);
+		Match = Match && Error <= TOLERANCE;
+		std::printf("%-8s %8.1f ns per pose, %5.1fx, max error %.2e%s\n", pose::getKernelName(Kernel), KernelMs * 1e6 / NUM_POSES, GlmMs / KernelMs,
+					Error, Error <= TOLERANCE ? "" : "  MISMATCH");
+	}
+	pose::setKernel(Default);
+
+	return Match ? 0 : 1;
+}
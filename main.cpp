@@ -2,9 +2,17 @@
 
 #include <glm/glm.hpp>
 
+#include <cstring>
+#include <memory>
+
 #include "src/Camera.h"
+#include "src/DebugDraw.h"
+#include "src/FrameUniforms.h"
 #include "src/Model.h"
 #include "src/Shader.h"
+#include "src/ShaderVariants.h"
+#include "src/Texture.h"
+#include "src/TextureCache.h"
 #include "src/VideoPlayer.h"
 #include "src/Window.h"
 #include "src/utils/Logger.h"
@@ -17,7 +25,6 @@ using namespace glm;
 // Prototypes.
 void keyCallback(Window &window, Camera &camera, double elapsed, const std::vector<bool> &keys, const std::vector<bool> &mouseKeys);
 void drawQuad();
-void drawLine(const glm::vec3 &v1, const glm::vec3 &v2);
 
 //Enable NVIDIA GPU usage
 #ifdef WIN32
@@ -28,6 +35,10 @@ extern "C"
 }
 #endif
 
+// Sampler uniforms of the mesh and quad shaders, hashed at compile time
+constexpr Shader::UniformName TEXTURE_UNIFORM("texture0");
+constexpr Shader::UniformName PANEL_UNIFORMS[] = {Shader::UniformName("t1"), Shader::UniformName("t2"), Shader::UniformName("t3")};
+
 constexpr size_t FRAMEBUFFER_COUNT = 2;
 enum Framebuffers
 {
@@ -36,11 +47,19 @@ enum Framebuffers
 	SKELETON = 1
 };
 
-int main()
+int main(int argc, char **argv)
 {
+	// --video-proxy plays the video from a half resolution raw proxy, created next to it on first use.
+	bool videoProxy = false;
+	for (int i = 1; i < argc; i++)
+		videoProxy = videoProxy || std::strcmp(argv[i], "--video-proxy") == 0;
+
 	DEBUG("Initializing window with dimensions: %i, %i.", WIDTH, HEIGHT);
 	auto window = Window(WIDTH, HEIGHT, "Computer Animation");
 
+	// Textures are cooked to BC1/BC3 where the driver can sample them
+	Texture::setCompression(GLEW_EXT_texture_compression_s3tc != 0);
+
 	auto skeletonCamera = Camera(vec3(21.5f, 23.5f, 110.0f), WIDTH / 3.0f, HEIGHT);
 	skeletonCamera.rotate(vec2(180.0f + 90.0f, 0.0f));
 	auto skinCamera = Camera(vec3(0.f, 0.4f, -3.0f), WIDTH / 3.0f, HEIGHT);
@@ -65,11 +84,19 @@ int main()
 
 	DEBUG("Loading video.");
 	// Load in video.
-	auto video = VideoPlayer("Data/video.mp4", 0, 701);
+	VideoPlayer video("Data/video.mp4", 0, 701, videoProxy ? 0.5f : 0.0f);
+
+	// The video panel shows a centered slice of the frame, only that part is uploaded.
+	constexpr float videoSlice = 0.31f;
+	const int videoSliceWidth = static_cast<int>(video.getFrameWidth() * videoSlice);
+	video.setCrop((video.getFrameWidth() - videoSliceWidth) / 2, 0, videoSliceWidth, video.getFrameHeight());
 
-	DEBUG("Loading skinned mesh: Data/Capture/capture.DAE");
-	Model mesh(true);
-	mesh.loadMesh("Data/Capture/capture.DAE");
+	// The capture loads on a worker thread, the empty mesh is shown until it is done.
+	constexpr const char *capturePath = "Data/Capture/capture.DAE";
+	DEBUG("Loading skinned mesh: %s", capturePath);
+	auto mesh = std::make_unique<Model>(true);
+	auto pendingMesh = std::make_unique<Model>(true);
+	pendingMesh->loadMeshAsync(capturePath);
 
 	// Enable depth testing.
 	glEnable(GL_DEPTH_TEST);
@@ -104,16 +131,28 @@ int main()
 	glBindFramebuffer(GL_FRAMEBUFFER, Framebuffers::WINDOW);
 
 	// Initialize shaders.
-	auto plotShader = Shader("Data/Shaders/quad.vert", "Data/Shaders/quad.frag");
-	auto shader = Shader("Data/Shaders/mesh.vert", "Data/Shaders/mesh.frag");
-	auto simple = Shader("Data/Shaders/simple.vert", "Data/Shaders/simple.frag");
-
-	// Set lighting arguments for mesh.
-	shader.bind();
-	shader.setUniformFloat("ambient", glm::vec3(0.1f));
-	shader.setUniformFloat("directionalLight.color", glm::normalize(glm::vec3(1)));
-	shader.setUniformFloat("directionalLight.direction", glm::normalize(glm::vec3(0.5f, 0.5f, -0.5f)));
-	shader.unbind();
+	Shader plotShader("Data/Shaders/quad.vert", "Data/Shaders/quad.frag");
+	ShaderVariants meshShaders("Data/Shaders/mesh.vert", "Data/Shaders/mesh.frag", Model::MESH_DEFINES);
+	DebugDraw debugDraw;
+
+	// Camera and lighting reach the mesh shaders through the frame block, updated once per frame.
+	FrameUniforms frameUniforms;
+	frameUniforms.init();
+	uniforms::Lighting lighting;
+	lighting.Ambient = glm::vec3(0.1f);
+	lighting.LightColor = glm::normalize(glm::vec3(1));
+	lighting.LightDirection = glm::normalize(glm::vec3(0.5f, 0.5f, -0.5f));
+	meshShaders.setSetup([](Shader &variant, uint32_t mask) {
+		uniforms::bindBlocks(variant);
+		if (mask & Model::MESH_SKINNED)
+			Model::bindBonePalette(variant);
+		if (mask & Model::MESH_TEXTURED)
+		{
+			variant.bind();
+			variant.setUniformInt(TEXTURE_UNIFORM, 0);
+			variant.unbind();
+		}
+	});
 
 	// Setup timing variables.
 	double last_time = glfwGetTime();
@@ -125,6 +164,17 @@ int main()
 	// For some reason OpenCV does not correctly detect that our video is 60 FPS...
 	double timeTillNextFrame = 1.0 / video.getFPS() * 2.0;
 
+	// Animation timings are averaged and shown in the window title once per second.
+	double statsElapsed = 0.0;
+	size_t statsFrames = 0;
+	Model::FrameStats statsTotal;
+
+	// The rig is queried every frame into the same vector.
+	int rigRoot = -1;
+	std::vector<Model::RigBone> rig;
+	bool toggleSkinningHeld = false;
+	bool reloadHeld = false;
+
 	// Load initial frame into video texture.
 	video.uploadNextFrame();
 
@@ -136,6 +186,44 @@ int main()
 		// Retrieve input events.
 		window.pollEvents();
 
+		// Swap in a capture once it finished loading, R reloads the capture in the background.
+		if (pendingMesh && pendingMesh->updateLoading() != Model::LoadState::Loading)
+		{
+			if (pendingMesh->getLoadState() == Model::LoadState::Ready)
+			{
+				pendingMesh->setSkinningMode(mesh->getSkinningMode());
+				std::swap(mesh, pendingMesh);
+				rigRoot = mesh->findNode("MiaFBXASC058Hips");
+				textures::logStats();
+			}
+			else
+			{
+				WARNING("Could not load %s", capturePath);
+			}
+			pendingMesh.reset();
+		}
+
+		const bool reload = window.pressed(GLFW_KEY_R);
+		if (reload && !reloadHeld && !pendingMesh)
+		{
+			DEBUG("Reloading skinned mesh: %s", capturePath);
+			pendingMesh = std::make_unique<Model>(true);
+			pendingMesh->loadMeshAsync(capturePath);
+		}
+		reloadHeld = reload;
+
+		// G switches between skinning on the CPU and on the GPU.
+		const bool toggleSkinning = window.pressed(GLFW_KEY_G);
+		if (toggleSkinning && !toggleSkinningHeld)
+		{
+			const bool onGpu = mesh->getSkinningMode() == Model::SkinningMode::GPU;
+			if (mesh->setSkinningMode(onGpu ? Model::SkinningMode::CPU : Model::SkinningMode::GPU))
+			{
+				DEBUG("Skinning on the %s", onGpu ? "CPU" : "GPU");
+			}
+		}
+		toggleSkinningHeld = toggleSkinning;
+
 		// Check if we need to load the next video frame to the GPU.
 		totalElapsedVideo += elapsed;
 		if (totalElapsedVideo > timeTillNextFrame)
@@ -152,13 +240,36 @@ int main()
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 		// Transform mesh with current animation keyframe, if it returns true -> animation was restarted.
-		if (mesh.transformBones(static_cast<float>(total)))
+		const bool restarted = mesh->transformBones(static_cast<float>(total));
+		mesh->getSkeletalRig(rigRoot, rig);
+
+		if (restarted)
 		{
 			video.reset();
 			video.uploadNextFrame();
 			total = animationOffset;
 		}
 
+		const auto &stats = mesh->getFrameStats();
+		statsTotal.SampleMs += stats.SampleMs;
+		statsTotal.PoseMs += stats.PoseMs;
+		statsTotal.SkinMs += stats.SkinMs;
+		statsElapsed += elapsed;
+		statsFrames++;
+		if (statsElapsed > 1.0)
+		{
+			char title[256];
+			const auto &upload = video.getUploadStats();
+			std::snprintf(title, sizeof(title), "Computer Animation - sample: %.3f ms, pose: %.3f ms, skin: %.3f ms, video upload: %.3f ms (GPU %.3f ms)",
+						  statsTotal.SampleMs / statsFrames, statsTotal.PoseMs / statsFrames, statsTotal.SkinMs / statsFrames, upload.SubmitMs,
+						  upload.GpuMs);
+			window.setTitle(title);
+
+			statsTotal = Model::FrameStats();
+			statsElapsed = 0.0;
+			statsFrames = 0;
+		}
+
 		// Draw mesh to first framebuffer.
 		glBindFramebuffer(GL_FRAMEBUFFER, FBOs[Framebuffers::SKINNED_MESH]);
 		glViewport(0, 0, WIDTH, HEIGHT);
@@ -167,32 +278,21 @@ int main()
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 		glClearColor(0, 0, 0, 1.0f);
 
-		shader.bind();
-		mesh.render(shader, skinCamera);
-		shader.unbind();
+		frameUniforms.update(skinCamera, lighting);
+		mesh->render(meshShaders);
+		frameUniforms.fence();
+		glUseProgram(0);
 
 		// Draw skeleton to second framebuffer.
 		glBindFramebuffer(GL_FRAMEBUFFER, FBOs[Framebuffers::SKELETON]);
 		glViewport(0, 0, WIDTH, HEIGHT);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 		glClearColor(0, 0, 0, 1.0f);
-		simple.bind();
 
 		const auto model = glm::translate(glm::identity<glm::mat4>(), glm::vec3(25.0f, -10.f, 0.f));
-		simple.setUniformFloat("MVP", skeletonCamera.getCombinedMatrix(model));
-
-		const auto rig = mesh.getSkeletalRig("MiaFBXASC058Hips");
 		for (const auto &bone : rig)
-		{
-			std::string name;
-			glm::vec3 start;
-			glm::vec3 end;
-
-			std::tie(name, start, end) = bone;
-
-			drawLine(start, end);
-		}
-		simple.unbind();
+			debugDraw.line(bone.Start, bone.End);
+		debugDraw.flush(skeletonCamera.getCombinedMatrix(model));
 
 		glBindFramebuffer(GL_FRAMEBUFFER, Framebuffers::WINDOW);
 
@@ -212,9 +312,8 @@ int main()
 		glDisable(GL_CULL_FACE);
 
 		// Set texture locations.
-		plotShader.setUniformInt("t1", 0);
-		plotShader.setUniformInt("t2", 1);
-		plotShader.setUniformInt("t3", 2);
+		for (int i = 0; i < 3; i++)
+			plotShader.setUniformInt(PANEL_UNIFORMS[i], i);
 		drawQuad();
 
 		// Reset sate.
@@ -322,26 +421,3 @@ void drawQuad()
 	glDrawArrays(GL_TRIANGLES, 0, 6);
 	glBindVertexArray(0);
 }
-
-void drawLine(const glm::vec3 &v1, const glm::vec3 &v2)
-{
-	static GLuint VBO = 0;
-	static GLuint VAO = 0;
-
-	if (!VBO || !VAO)
-	{
-		glGenBuffers(1, &VBO);
-		glGenVertexArrays(1, &VAO);
-	}
-
-	const glm::vec3 data[2] = {v1, v2};
-
-	glBindVertexArray(VAO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, 2 * sizeof(glm::vec3), data, GL_DYNAMIC_DRAW);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void *)0);
-
-	glLineWidth(3.0f);
-	glDrawArrays(GL_LINES, 0, 3);
-}
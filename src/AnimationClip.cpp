@@ -0,0 +1,201 @@
+#include "AnimationClip.h"
+
+#include "utils/Logger.h"
+
+#include <algorithm>
+#include <map>
+
+/// Numbers all nodes below pNode in depth-first order, the first node with a given name wins
+static void numberNodes(const aiNode *pNode, unsigned int &Counter, std::map<std::string, unsigned int> &Numbers)
+{
+	Numbers.emplace(pNode->mName.C_Str(), Counter++);
+
+	for (unsigned int i = 0; i < pNode->mNumChildren; i++)
+		numberNodes(pNode->mChildren[i], Counter, Numbers);
+}
+
+/// Linearly interpolates between the two keyframes surrounding AnimationTime
+static glm::vec3 sampleVector(float AnimationTime, const float *Times, const glm::vec3 *Keys, unsigned int NumKeys, unsigned int &Cursor)
+{
+	// If there is only one keyframe then we don't interpolate
+	if (NumKeys == 1)
+		return Keys[0];
+
+	const unsigned int Index = findKeyframe(AnimationTime, NumKeys, Cursor, [Times](unsigned int i) { return Times[i]; });
+	const float DeltaTime = Times[Index + 1] - Times[Index];
+	const float Factor = glm::clamp((AnimationTime - Times[Index]) / DeltaTime, 0.0f, 1.0f);
+
+	return glm::mix(Keys[Index], Keys[Index + 1], Factor);
+}
+
+/// Spherically interpolates between the two keyframes surrounding AnimationTime
+static glm::quat sampleRotation(float AnimationTime, const float *Times, const glm::quat *Keys, unsigned int NumKeys, unsigned int &Cursor)
+{
+	// If there is only one keyframe then we don't interpolate
+	if (NumKeys == 1)
+		return Keys[0];
+
+	const unsigned int Index = findKeyframe(AnimationTime, NumKeys, Cursor, [Times](unsigned int i) { return Times[i]; });
+	const float DeltaTime = Times[Index + 1] - Times[Index];
+	const float Factor = glm::clamp((AnimationTime - Times[Index]) / DeltaTime, 0.0f, 1.0f);
+
+	return glm::normalize(glm::slerp(Keys[Index], Keys[Index + 1], Factor));
+}
+
+bool AnimationClip::compile(const aiAnimation *pAnimation, const aiNode *pRoot)
+{
+	m_Duration = static_cast<float>(pAnimation->mDuration);
+	m_TicksPerSecond = static_cast<float>(pAnimation->mTicksPerSecond != 0 ? pAnimation->mTicksPerSecond : 25.0);
+
+	std::map<std::string, unsigned int> NodeNumbers;
+	unsigned int NumNodes = 0;
+	numberNodes(pRoot, NumNodes, NodeNumbers);
+
+	// Collect the animated nodes, sorted by their position in the hierarchy
+	std::vector<std::pair<unsigned int, const aiNodeAnim *>> Channels;
+	Channels.reserve(pAnimation->mNumChannels);
+	for (unsigned int i = 0; i < pAnimation->mNumChannels; i++)
+	{
+		const aiNodeAnim *pNodeAnim = pAnimation->mChannels[i];
+		const auto Node = NodeNumbers.find(pNodeAnim->mNodeName.C_Str());
+
+		if (Node == NodeNumbers.end())
+		{
+			WARNING("Animation channel '%s' does not match any node, skipping.", pNodeAnim->mNodeName.C_Str());
+			continue;
+		}
+
+		if (pNodeAnim->mNumPositionKeys == 0 || pNodeAnim->mNumRotationKeys == 0 || pNodeAnim->mNumScalingKeys == 0)
+		{
+			WARNING("Animation channel '%s' is missing keys, skipping.", pNodeAnim->mNodeName.C_Str());
+			continue;
+		}
+
+		Channels.emplace_back(Node->second, pNodeAnim);
+	}
+
+	std::sort(Channels.begin(), Channels.end(),
+			  [](const std::pair<unsigned int, const aiNodeAnim *> &a, const std::pair<unsigned int, const aiNodeAnim *> &b) { return a.first < b.first; });
+
+	m_Tracks.clear();
+	m_TrackNames.clear();
+	m_PositionTimes.clear();
+	m_Positions.clear();
+	m_RotationTimes.clear();
+	m_Rotations.clear();
+	m_ScalingTimes.clear();
+	m_Scalings.clear();
+
+	m_Tracks.reserve(Channels.size());
+	m_TrackNames.reserve(Channels.size());
+
+	for (const auto &Channel : Channels)
+	{
+		const aiNodeAnim *pNodeAnim = Channel.second;
+
+		Track track;
+		track.Node = Channel.first;
+
+		track.FirstPosition = static_cast<unsigned int>(m_Positions.size());
+		track.NumPositions = pNodeAnim->mNumPositionKeys;
+		for (unsigned int i = 0; i < pNodeAnim->mNumPositionKeys; i++)
+		{
+			const aiVectorKey &Key = pNodeAnim->mPositionKeys[i];
+			m_PositionTimes.push_back(static_cast<float>(Key.mTime));
+			m_Positions.emplace_back(Key.mValue.x, Key.mValue.y, Key.mValue.z);
+		}
+
+		track.FirstRotation = static_cast<unsigned int>(m_Rotations.size());
+		track.NumRotations = pNodeAnim->mNumRotationKeys;
+		for (unsigned int i = 0; i < pNodeAnim->mNumRotationKeys; i++)
+		{
+			const aiQuatKey &Key = pNodeAnim->mRotationKeys[i];
+			m_RotationTimes.push_back(static_cast<float>(Key.mTime));
+			m_Rotations.emplace_back(Key.mValue.w, Key.mValue.x, Key.mValue.y, Key.mValue.z);
+		}
+
+		track.FirstScaling = static_cast<unsigned int>(m_Scalings.size());
+		track.NumScalings = pNodeAnim->mNumScalingKeys;
+		for (unsigned int i = 0; i < pNodeAnim->mNumScalingKeys; i++)
+		{
+			const aiVectorKey &Key = pNodeAnim->mScalingKeys[i];
+			m_ScalingTimes.push_back(static_cast<float>(Key.mTime));
+			m_Scalings.emplace_back(Key.mValue.x, Key.mValue.y, Key.mValue.z);
+		}
+
+		m_Tracks.push_back(track);
+		m_TrackNames.emplace_back(pNodeAnim->mNodeName.C_Str());
+	}
+
+	return !m_Tracks.empty();
+}
+
+void AnimationClip::sample(float AnimationTime, std::vector<KeyframeCursor> &Cursors, PoseStreams &Pose) const
+{
+	assert(Cursors.size() >= m_Tracks.size());
+	assert(Pose.size() >= m_Tracks.size());
+
+	for (size_t i = 0; i < m_Tracks.size(); i++)
+	{
+		const Track &track = m_Tracks[i];
+		KeyframeCursor &Cursor = Cursors[i];
+
+		const glm::quat Rotation = sampleRotation(AnimationTime, &m_RotationTimes[track.FirstRotation], &m_Rotations[track.FirstRotation], track.NumRotations, Cursor.Rotation);
+
+		Pose.setTranslation(static_cast<unsigned int>(i), sampleVector(AnimationTime, &m_PositionTimes[track.FirstPosition], &m_Positions[track.FirstPosition], track.NumPositions, Cursor.Position));
+		Pose.setRotation(static_cast<unsigned int>(i), Rotation.x, Rotation.y, Rotation.z, Rotation.w);
+		Pose.setScale(static_cast<unsigned int>(i), sampleVector(AnimationTime, &m_ScalingTimes[track.FirstScaling], &m_Scalings[track.FirstScaling], track.NumScalings, Cursor.Scaling));
+	}
+}
+
+/// Whether [First, First + Count) is a non-empty range inside an array of Size keys, without overflowing
+static bool isKeyRange(unsigned int First, unsigned int Count, size_t Size)
+{
+	return Count > 0 && First <= Size && Count <= Size - First;
+}
+
+void AnimationClip::write(utils::BinaryWriter &Writer) const
+{
+	Writer.write(m_Duration);
+	Writer.write(m_TicksPerSecond);
+	Writer.writeArray(m_Tracks);
+	for (const auto &Name : m_TrackNames)
+		Writer.writeString(Name);
+
+	Writer.writeArray(m_PositionTimes);
+	Writer.writeArray(m_Positions);
+	Writer.writeArray(m_RotationTimes);
+	Writer.writeArray(m_Rotations);
+	Writer.writeArray(m_ScalingTimes);
+	Writer.writeArray(m_Scalings);
+}
+
+bool AnimationClip::read(utils::BinaryReader &Reader)
+{
+	m_Duration = Reader.read<float>();
+	m_TicksPerSecond = Reader.read<float>();
+	Reader.readArray(m_Tracks);
+	m_TrackNames.resize(m_Tracks.size());
+	for (auto &Name : m_TrackNames)
+		Name = Reader.readString();
+
+	Reader.readArray(m_PositionTimes);
+	Reader.readArray(m_Positions);
+	Reader.readArray(m_RotationTimes);
+	Reader.readArray(m_Rotations);
+	Reader.readArray(m_ScalingTimes);
+	Reader.readArray(m_Scalings);
+	if (!Reader.ok())
+		return false;
+
+	// Key ranges of every track need to be non-empty and lie inside the key arrays
+	for (const auto &Track : m_Tracks)
+	{
+		if (!isKeyRange(Track.FirstPosition, Track.NumPositions, m_Positions.size()) ||
+			!isKeyRange(Track.FirstRotation, Track.NumRotations, m_Rotations.size()) ||
+			!isKeyRange(Track.FirstScaling, Track.NumScalings, m_Scalings.size()))
+			return false;
+	}
+
+	return m_PositionTimes.size() == m_Positions.size() && m_RotationTimes.size() == m_Rotations.size() && m_ScalingTimes.size() == m_Scalings.size();
+}
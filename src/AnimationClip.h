@@ -0,0 +1,87 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <assimp/scene.h>
+
+#include "KeyframeSearch.h"
+#include "PoseKernel.h"
+#include "utils/BinaryStream.h"
+
+/*
+ * Runtime animation clip, compiled once from an aiAnimation at load time.
+ * Key times are stored as float and keys of every track are packed into
+ * contiguous per-type arrays, so sampling never touches Assimp data.
+ */
+class AnimationClip
+{
+  public:
+	struct Track
+	{
+		// Depth-first index of the animated node, tracks are sorted by it
+		unsigned int Node = 0;
+
+		unsigned int FirstPosition = 0;
+		unsigned int NumPositions = 0;
+		unsigned int FirstRotation = 0;
+		unsigned int NumRotations = 0;
+		unsigned int FirstScaling = 0;
+		unsigned int NumScalings = 0;
+	};
+
+	/*
+	 * Compiles given animation. Nodes are numbered in depth-first order starting at pRoot,
+	 * channels that do not animate a node in this hierarchy are dropped.
+	 */
+	bool compile(const aiAnimation *pAnimation, const aiNode *pRoot);
+
+	/*
+	 * Samples every track at AnimationTime (in ticks), lane i of Pose receives track i.
+	 * @param AnimationTime		Time in ticks
+	 * @param Cursors			Keyframe cursors, one per track
+	 * @param Pose				Output pose, needs to hold getTrackCount() lanes
+	 */
+	void sample(float AnimationTime, std::vector<KeyframeCursor> &Cursors, PoseStreams &Pose) const;
+
+	/*
+	 * Returns duration of clip in ticks.
+	 */
+	float getDuration() const { return m_Duration; }
+
+	/*
+	 * Returns number of ticks per second, defaults to 25 if the source did not specify it.
+	 */
+	float getTicksPerSecond() const { return m_TicksPerSecond; }
+
+	unsigned int getTrackCount() const { return static_cast<unsigned int>(m_Tracks.size()); }
+	const Track &getTrack(unsigned int i) const { return m_Tracks[i]; }
+
+	/*
+	 * Returns name of the node animated by track i.
+	 */
+	const std::string &getTrackName(unsigned int i) const { return m_TrackNames[i]; }
+
+	/*
+	 * Serializes the compiled clip, read() restores it and returns false on truncated data.
+	 */
+	void write(utils::BinaryWriter &Writer) const;
+	bool read(utils::BinaryReader &Reader);
+
+  private:
+	float m_Duration = 0.0f;
+	float m_TicksPerSecond = 25.0f;
+
+	std::vector<Track> m_Tracks;
+	std::vector<std::string> m_TrackNames;
+
+	std::vector<float> m_PositionTimes;
+	std::vector<glm::vec3> m_Positions;
+	std::vector<float> m_RotationTimes;
+	std::vector<glm::quat> m_Rotations;
+	std::vector<float> m_ScalingTimes;
+	std::vector<glm::vec3> m_Scalings;
+};
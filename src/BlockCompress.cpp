@@ -0,0 +1,298 @@
+#include "BlockCompress.h"
+
+#include "utils/BinaryStream.h"
+#include "utils/MappedFile.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace bcn
+{
+
+constexpr uint32_t CACHE_MAGIC = 0x4e434254; // "TBCN"
+constexpr uint32_t CACHE_VERSION = 1;
+
+size_t blockSize(Format Encoding)
+{
+	return Encoding == Format::BC1 ? 8 : 16;
+}
+
+bool hasAlpha(const unsigned int *Rgba, size_t Count)
+{
+	const unsigned char *Bytes = reinterpret_cast<const unsigned char *>(Rgba);
+	for (size_t i = 0; i < Count; i++)
+		if (Bytes[4 * i + 3] != 0xFF)
+			return true;
+
+	return false;
+}
+
+static inline uint16_t toRgb565(const int *Color)
+{
+	return static_cast<uint16_t>(((Color[0] >> 3) << 11) | ((Color[1] >> 2) << 5) | (Color[2] >> 3));
+}
+
+static inline void fromRgb565(uint16_t Packed, int *Color)
+{
+	const int r = (Packed >> 11) & 31, g = (Packed >> 5) & 63, b = Packed & 31;
+	Color[0] = (r << 3) | (r >> 2);
+	Color[1] = (g << 2) | (g >> 4);
+	Color[2] = (b << 3) | (b >> 2);
+}
+
+/// Copies a 4x4 block of pixels, repeating the last row and column for blocks crossing the image border
+static void gatherBlock(const unsigned int *Pixels, unsigned int Width, unsigned int Height, unsigned int BlockX, unsigned int BlockY,
+						unsigned char *Block)
+{
+	for (unsigned int y = 0; y < 4; y++)
+	{
+		const unsigned int SrcY = std::min(BlockY * 4 + y, Height - 1);
+		for (unsigned int x = 0; x < 4; x++)
+		{
+			const unsigned int SrcX = std::min(BlockX * 4 + x, Width - 1);
+			std::memcpy(Block + 4 * (y * 4 + x), Pixels + static_cast<size_t>(SrcY) * Width + SrcX, 4);
+		}
+	}
+}
+
+/// Four color block with end points on the inset bounding box of the block colors
+static void encodeColor(const unsigned char *Block, unsigned char *Out)
+{
+	int Min[3] = {255, 255, 255}, Max[3] = {0, 0, 0};
+	for (int i = 0; i < 16; i++)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			Min[c] = std::min<int>(Min[c], Block[4 * i + c]);
+			Max[c] = std::max<int>(Max[c], Block[4 * i + c]);
+		}
+	}
+
+	// Pulling the end points inwards lowers the average error of the interpolated colors
+	for (int c = 0; c < 3; c++)
+	{
+		const int Inset = (Max[c] - Min[c]) >> 4;
+		Min[c] += Inset;
+		Max[c] -= Inset;
+	}
+
+	// The first end point has to be larger, otherwise the block is decoded in three color mode
+	uint16_t Color0 = toRgb565(Max), Color1 = toRgb565(Min);
+	if (Color0 < Color1)
+		std::swap(Color0, Color1);
+
+	int Palette[4][3];
+	fromRgb565(Color0, Palette[0]);
+	fromRgb565(Color1, Palette[1]);
+	for (int c = 0; c < 3; c++)
+	{
+		Palette[2][c] = (2 * Palette[0][c] + Palette[1][c]) / 3;
+		Palette[3][c] = (Palette[0][c] + 2 * Palette[1][c]) / 3;
+	}
+
+	uint32_t Indices = 0;
+	if (Color0 != Color1)
+	{
+		for (int i = 0; i < 16; i++)
+		{
+			int Best = 0, BestError = 0x7FFFFFFF;
+			for (int p = 0; p < 4; p++)
+			{
+				int Error = 0;
+				for (int c = 0; c < 3; c++)
+				{
+					const int d = Block[4 * i + c] - Palette[p][c];
+					Error += d * d;
+				}
+				if (Error < BestError)
+				{
+					Best = p;
+					BestError = Error;
+				}
+			}
+			Indices |= static_cast<uint32_t>(Best) << (2 * i);
+		}
+	}
+
+	Out[0] = static_cast<unsigned char>(Color0 & 0xFF);
+	Out[1] = static_cast<unsigned char>(Color0 >> 8);
+	Out[2] = static_cast<unsigned char>(Color1 & 0xFF);
+	Out[3] = static_cast<unsigned char>(Color1 >> 8);
+	for (int i = 0; i < 4; i++)
+		Out[4 + i] = static_cast<unsigned char>(Indices >> (8 * i));
+}
+
+/// Eight value alpha block between the smallest and largest alpha of the block
+static void encodeAlpha(const unsigned char *Block, unsigned char *Out)
+{
+	int Min = 255, Max = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		Min = std::min<int>(Min, Block[4 * i + 3]);
+		Max = std::max<int>(Max, Block[4 * i + 3]);
+	}
+
+	int Palette[8] = {Max, Min};
+	for (int p = 2; p < 8; p++)
+		Palette[p] = ((8 - p) * Max + (p - 1) * Min) / 7;
+
+	uint64_t Indices = 0;
+	if (Max > Min)
+	{
+		for (int i = 0; i < 16; i++)
+		{
+			int Best = 0, BestError = 256;
+			for (int p = 0; p < 8; p++)
+			{
+				const int Error = std::abs(Block[4 * i + 3] - Palette[p]);
+				if (Error < BestError)
+				{
+					Best = p;
+					BestError = Error;
+				}
+			}
+			Indices |= static_cast<uint64_t>(Best) << (3 * i);
+		}
+	}
+
+	Out[0] = static_cast<unsigned char>(Max);
+	Out[1] = static_cast<unsigned char>(Min);
+	for (int i = 0; i < 6; i++)
+		Out[2 + i] = static_cast<unsigned char>(Indices >> (8 * i));
+}
+
+static void encodeLevel(const unsigned int *Pixels, unsigned int Width, unsigned int Height, Format Encoding, unsigned char *Out)
+{
+	const size_t BlockBytes = blockSize(Encoding);
+	const unsigned int BlocksX = (Width + 3) / 4;
+	const int BlocksY = static_cast<int>((Height + 3) / 4);
+
+#pragma omp parallel for schedule(dynamic)
+	for (int by = 0; by < BlocksY; by++)
+	{
+		unsigned char Block[64];
+		unsigned char *Dst = Out + static_cast<size_t>(by) * BlocksX * BlockBytes;
+		for (unsigned int bx = 0; bx < BlocksX; bx++, Dst += BlockBytes)
+		{
+			gatherBlock(Pixels, Width, Height, bx, static_cast<unsigned int>(by), Block);
+			if (Encoding == Format::BC3)
+			{
+				encodeAlpha(Block, Dst);
+				encodeColor(Block, Dst + 8);
+			}
+			else
+				encodeColor(Block, Dst);
+		}
+	}
+}
+
+/// Averages 2x2 pixels, odd sizes reuse the last row or column
+static void downsample(const unsigned int *Src, unsigned int Width, unsigned int Height, unsigned int *Dst, unsigned int DstWidth,
+					   unsigned int DstHeight)
+{
+	const unsigned char *Bytes = reinterpret_cast<const unsigned char *>(Src);
+	unsigned char *Out = reinterpret_cast<unsigned char *>(Dst);
+
+	const int Rows = static_cast<int>(DstHeight);
+#pragma omp parallel for schedule(static)
+	for (int y = 0; y < Rows; y++)
+	{
+		const size_t Row0 = static_cast<size_t>(std::min(2u * y, Height - 1)) * Width;
+		const size_t Row1 = static_cast<size_t>(std::min(2u * y + 1, Height - 1)) * Width;
+		for (unsigned int x = 0; x < DstWidth; x++)
+		{
+			const unsigned int x0 = std::min(2 * x, Width - 1), x1 = std::min(2 * x + 1, Width - 1);
+			unsigned char *Pixel = Out + 4 * (static_cast<size_t>(y) * DstWidth + x);
+			for (int c = 0; c < 4; c++)
+			{
+				const int Sum = Bytes[4 * (Row0 + x0) + c] + Bytes[4 * (Row0 + x1) + c] + Bytes[4 * (Row1 + x0) + c] + Bytes[4 * (Row1 + x1) + c];
+				Pixel[c] = static_cast<unsigned char>((Sum + 2) / 4);
+			}
+		}
+	}
+}
+
+static uint64_t levelSize(unsigned int Width, unsigned int Height, Format Encoding)
+{
+	return static_cast<uint64_t>((Width + 3) / 4) * ((Height + 3) / 4) * blockSize(Encoding);
+}
+
+void compress(const unsigned int *Rgba, unsigned int Width, unsigned int Height, Format Encoding, CompressedImage &Out)
+{
+	Out.Encoding = Encoding;
+	Out.Levels.clear();
+	Out.Data.clear();
+	if (Width == 0 || Height == 0)
+		return;
+
+	// Lay out all levels first, so every level is encoded straight into the output
+	uint64_t Offset = 0;
+	for (unsigned int w = Width, h = Height;; w = std::max(w / 2, 1u), h = std::max(h / 2, 1u))
+	{
+		const uint64_t Size = levelSize(w, h, Encoding);
+		Out.Levels.push_back({w, h, Offset, Size});
+		Offset += Size;
+		if (w == 1 && h == 1)
+			break;
+	}
+	Out.Data.resize(static_cast<size_t>(Offset));
+
+	std::vector<unsigned int> Current, Next;
+	const unsigned int *Pixels = Rgba;
+	for (size_t i = 0; i < Out.Levels.size(); i++)
+	{
+		const MipLevel &Level = Out.Levels[i];
+		if (i > 0)
+		{
+			const MipLevel &Parent = Out.Levels[i - 1];
+			Next.resize(static_cast<size_t>(Level.Width) * Level.Height);
+			downsample(Pixels, Parent.Width, Parent.Height, Next.data(), Level.Width, Level.Height);
+			Current.swap(Next);
+			Pixels = Current.data();
+		}
+
+		encodeLevel(Pixels, Level.Width, Level.Height, Encoding, Out.Data.data() + Level.Offset);
+	}
+}
+
+bool save(const std::string &Path, uint64_t SourceHash, const CompressedImage &Image)
+{
+	utils::BinaryWriter Writer;
+	Writer.write(CACHE_MAGIC);
+	Writer.write(CACHE_VERSION);
+	Writer.write(SourceHash);
+	Writer.write(Image.Encoding);
+	Writer.writeArray(Image.Levels);
+	Writer.writeArray(Image.Data);
+	return Writer.save(Path);
+}
+
+bool load(const std::string &Path, uint64_t SourceHash, CompressedImage &Image)
+{
+	utils::MappedFile Cache;
+	if (!Cache.open(Path))
+		return false;
+
+	utils::BinaryReader Reader(Cache.data(), Cache.size());
+	if (Reader.read<uint32_t>() != CACHE_MAGIC || Reader.read<uint32_t>() != CACHE_VERSION || Reader.read<uint64_t>() != SourceHash)
+		return false;
+
+	Image.Encoding = Reader.read<Format>();
+	Reader.readArray(Image.Levels);
+	Reader.readArray(Image.Data);
+	if (!Reader.ok() || Image.Levels.empty() || (Image.Encoding != Format::BC1 && Image.Encoding != Format::BC3))
+		return false;
+
+	// Every level has to match its size and lie inside the data
+	for (const MipLevel &Level : Image.Levels)
+	{
+		if (Level.Width == 0 || Level.Height == 0 || Level.Size != levelSize(Level.Width, Level.Height, Image.Encoding) ||
+			Level.Offset > Image.Data.size() || Image.Data.size() - Level.Offset < Level.Size)
+			return false;
+	}
+
+	return true;
+}
+
+} // namespace bcn
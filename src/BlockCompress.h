@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * CPU encoder for block compressed textures. Images are cooked once into a full mip chain of
+ * 4x4 blocks and stored next to their source, so later loads upload them without decoding.
+ */
+namespace bcn
+{
+
+enum class Format : uint32_t
+{
+	BC1, // RGB, 8 bytes per block
+	BC3	 // RGBA, 16 bytes per block
+};
+
+struct MipLevel
+{
+	unsigned int Width;
+	unsigned int Height;
+	uint64_t Offset; // First byte of the level in CompressedImage::Data
+	uint64_t Size;
+};
+
+struct CompressedImage
+{
+	Format Encoding = Format::BC1;
+	std::vector<MipLevel> Levels;
+	std::vector<unsigned char> Data;
+
+	unsigned int getWidth() const { return Levels.empty() ? 0 : Levels[0].Width; }
+	unsigned int getHeight() const { return Levels.empty() ? 0 : Levels[0].Height; }
+};
+
+/*
+ * Bytes used by one 4x4 block
+ */
+size_t blockSize(Format Encoding);
+
+/*
+ * Whether any pixel is not fully opaque, decides between BC1 and BC3
+ */
+bool hasAlpha(const unsigned int *Rgba, size_t Count);
+
+/*
+ * Encodes an RGBA image and all of its mip levels down to 1x1.
+ * Mip levels are box filtered, blocks of a level are encoded in parallel.
+ * @param Rgba			Width * Height tightly packed pixels
+ * @param Width			Pixels per row
+ * @param Height		Number of rows
+ * @param Encoding		Block format
+ * @param Out			Receives the levels
+ */
+void compress(const unsigned int *Rgba, unsigned int Width, unsigned int Height, Format Encoding, CompressedImage &Out);
+
+/*
+ * Writes a cooked image, SourceHash identifies the source it was created from
+ * @return 	False if the file could not be written
+ */
+bool save(const std::string &Path, uint64_t SourceHash, const CompressedImage &Image);
+
+/*
+ * Reads a cooked image
+ * @return 	False if the file is missing, damaged or was cooked from a different source
+ */
+bool load(const std::string &Path, uint64_t SourceHash, CompressedImage &Image);
+
+} // namespace bcn
@@ -0,0 +1,126 @@
+#include "DebugDraw.h"
+
+#include "utils/Logger.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+constexpr Shader::UniformName MVP_UNIFORM("MVP");
+
+DebugDraw::DebugDraw() : m_Shader("Data/Shaders/debug.vert", "Data/Shaders/debug.frag")
+{
+	m_Lines.reserve(INITIAL_VERTICES);
+	m_Points.reserve(INITIAL_VERTICES);
+	m_Stream.init(sizeof(Vertex) * INITIAL_VERTICES, FRAMES_IN_FLIGHT);
+
+	// Lines and points share the vertex format, the buffer offset is set every flush
+	glCreateVertexArrays(1, &m_VAO);
+	glEnableVertexArrayAttrib(m_VAO, 0);
+	glVertexArrayAttribFormat(m_VAO, 0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Position));
+	glVertexArrayAttribBinding(m_VAO, 0, 0);
+	glEnableVertexArrayAttrib(m_VAO, 1);
+	glVertexArrayAttribFormat(m_VAO, 1, 4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(Vertex, Color));
+	glVertexArrayAttribBinding(m_VAO, 1, 0);
+}
+
+DebugDraw::~DebugDraw()
+{
+	if (m_VAO)
+		glDeleteVertexArrays(1, &m_VAO);
+}
+
+uint32_t DebugDraw::packColor(const glm::vec3 &Color)
+{
+	const glm::uvec3 Bytes(glm::clamp(Color, 0.0f, 1.0f) * 255.0f + 0.5f);
+	return Bytes.r | (Bytes.g << 8) | (Bytes.b << 16) | 0xFF000000u;
+}
+
+void DebugDraw::line(const glm::vec3 &From, const glm::vec3 &To, const glm::vec3 &Color)
+{
+	const uint32_t Packed = packColor(Color);
+	m_Lines.push_back({From, Packed});
+	m_Lines.push_back({To, Packed});
+}
+
+void DebugDraw::point(const glm::vec3 &Position, const glm::vec3 &Color)
+{
+	m_Points.push_back({Position, packColor(Color)});
+}
+
+void DebugDraw::box(const glm::vec3 &Min, const glm::vec3 &Max, const glm::vec3 &Color)
+{
+	// Corner i takes x, y and z from Max where bit 0, 1 or 2 of i is set
+	glm::vec3 Corners[8];
+	for (int i = 0; i < 8; i++)
+		Corners[i] = glm::vec3(i & 1 ? Max.x : Min.x, i & 2 ? Max.y : Min.y, i & 4 ? Max.z : Min.z);
+
+	// Every edge connects two corners that differ in one bit
+	for (int i = 0; i < 8; i++)
+	{
+		for (int Bit = 1; Bit < 8; Bit <<= 1)
+		{
+			if (!(i & Bit))
+				line(Corners[i], Corners[i | Bit], Color);
+		}
+	}
+}
+
+void DebugDraw::axes(const glm::mat4 &Transform, float Size)
+{
+	const glm::vec3 Origin(Transform[3]);
+	for (int i = 0; i < 3; i++)
+	{
+		glm::vec3 Color(0.0f);
+		Color[i] = 1.0f;
+		line(Origin, Origin + glm::vec3(Transform[i]) * Size, Color);
+	}
+}
+
+void DebugDraw::flush(const glm::mat4 &ViewProjection)
+{
+	const size_t NumLines = m_Lines.size(), NumPoints = m_Points.size();
+	if (NumLines + NumPoints == 0)
+		return;
+
+	// Grow the stream for busier frames, the old buffer is released once the GPU is done with it
+	const GLsizeiptr Size = sizeof(Vertex) * (NumLines + NumPoints);
+	if (Size > m_Stream.getRegionSize() && !m_Stream.init(std::max(Size, 2 * m_Stream.getRegionSize()), FRAMES_IN_FLIGHT))
+	{
+		WARNING("Could not grow debug draw buffer to %zu vertices", NumLines + NumPoints);
+		m_Lines.clear();
+		m_Points.clear();
+		return;
+	}
+
+	// One upload for all primitives, points follow the lines
+	Vertex *pVertices = static_cast<Vertex *>(m_Stream.map());
+	memcpy(pVertices, m_Lines.data(), sizeof(Vertex) * NumLines);
+	memcpy(pVertices + NumLines, m_Points.data(), sizeof(Vertex) * NumPoints);
+	m_Stream.unmap();
+	glVertexArrayVertexBuffer(m_VAO, 0, m_Stream.getBuffer(), m_Stream.getRegionOffset(), sizeof(Vertex));
+
+	m_Shader.bind();
+	m_Shader.setUniformFloat(MVP_UNIFORM, ViewProjection);
+	glBindVertexArray(m_VAO);
+
+	if (NumLines > 0)
+	{
+		glLineWidth(m_LineWidth);
+		glDrawArrays(GL_LINES, 0, static_cast<GLsizei>(NumLines));
+	}
+
+	if (NumPoints > 0)
+	{
+		glPointSize(m_PointSize);
+		glDrawArrays(GL_POINTS, static_cast<GLint>(NumLines), static_cast<GLsizei>(NumPoints));
+	}
+
+	glBindVertexArray(0);
+	m_Shader.unbind();
+	m_Stream.fence();
+
+	// Clearing keeps the capacity, so later frames do not allocate
+	m_Lines.clear();
+	m_Points.clear();
+}
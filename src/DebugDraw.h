@@ -0,0 +1,70 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "Shader.h"
+#include "StreamBuffer.h"
+
+#include <cstdint>
+#include <vector>
+
+/*
+ * Collects lines and points during a frame and draws them with one upload and one draw call
+ * per primitive type. Boxes and axes are made of lines. Vertices are written into a stream
+ * buffer, so flushing never allocates or waits for the GPU once the buffer is large enough.
+ */
+class DebugDraw
+{
+  public:
+	DebugDraw();
+	~DebugDraw();
+
+	DebugDraw(const DebugDraw &) = delete;
+	DebugDraw &operator=(const DebugDraw &) = delete;
+
+	void line(const glm::vec3 &From, const glm::vec3 &To, const glm::vec3 &Color = glm::vec3(1.0f));
+	void point(const glm::vec3 &Position, const glm::vec3 &Color = glm::vec3(1.0f));
+
+	/*
+	 * Adds the twelve edges of an axis aligned box
+	 */
+	void box(const glm::vec3 &Min, const glm::vec3 &Max, const glm::vec3 &Color = glm::vec3(1.0f));
+
+	/*
+	 * Adds the x, y and z axis of Transform as red, green and blue lines of length Size
+	 */
+	void axes(const glm::mat4 &Transform, float Size = 1.0f);
+
+	/*
+	 * Draws everything added since the last flush with the same transform and clears it
+	 * @param ViewProjection 	Transform from world to clip space
+	 */
+	void flush(const glm::mat4 &ViewProjection);
+
+	void setLineWidth(float Width) { m_LineWidth = Width; }
+	void setPointSize(float Size) { m_PointSize = Size; }
+
+  private:
+	struct Vertex
+	{
+		glm::vec3 Position;
+		uint32_t Color; // RGBA8
+	};
+
+	static constexpr unsigned int FRAMES_IN_FLIGHT = 3;
+	static constexpr size_t INITIAL_VERTICES = 4096;
+
+	static uint32_t packColor(const glm::vec3 &Color);
+
+	std::vector<Vertex> m_Lines;
+	std::vector<Vertex> m_Points;
+
+	Shader m_Shader;
+	StreamBuffer m_Stream;
+	GLuint m_VAO = 0;
+
+	float m_LineWidth = 3.0f;
+	float m_PointSize = 6.0f;
+};
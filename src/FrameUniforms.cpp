@@ -0,0 +1,68 @@
+#include "FrameUniforms.h"
+
+#include "Camera.h"
+#include "Shader.h"
+#include "utils/Logger.h"
+
+#include <algorithm>
+
+namespace uniforms
+{
+
+static void bindBlock(GLuint Program, const char *Name, GLuint Binding)
+{
+	const GLuint Block = glGetUniformBlockIndex(Program, Name);
+	if (Block != GL_INVALID_INDEX)
+		glUniformBlockBinding(Program, Block, Binding);
+}
+
+void bindBlocks(const Shader &shader)
+{
+	bindBlock(shader.getShaderId(), "Frame", FRAME_BINDING);
+	bindBlock(shader.getShaderId(), "Draw", DRAW_BINDING);
+}
+
+GLsizeiptr getDrawBlockStride()
+{
+	static GLsizeiptr Stride = 0;
+	if (Stride == 0)
+	{
+		GLint Alignment = 256;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &Alignment);
+		Alignment = std::max(Alignment, 1);
+		Stride = (sizeof(DrawBlock) + Alignment - 1) / Alignment * Alignment;
+	}
+
+	return Stride;
+}
+
+} // namespace uniforms
+
+bool FrameUniforms::init()
+{
+	if (!m_Stream.init(sizeof(uniforms::FrameBlock), FRAMES_IN_FLIGHT))
+	{
+		WARNING("Could not create frame uniform buffer");
+		return false;
+	}
+
+	return true;
+}
+
+void FrameUniforms::update(const Camera &camera, const uniforms::Lighting &lighting)
+{
+	uniforms::FrameBlock *pBlock = static_cast<uniforms::FrameBlock *>(m_Stream.map());
+	pBlock->ViewProjection = camera.getCombinedMatrix();
+	pBlock->CameraPosition = glm::vec4(camera.getPosition(), 1.0f);
+	pBlock->Ambient = glm::vec4(lighting.Ambient, 0.0f);
+	pBlock->LightColor = glm::vec4(lighting.LightColor, 0.0f);
+	pBlock->LightDirection = glm::vec4(lighting.LightDirection, 0.0f);
+	m_Stream.unmap();
+
+	glBindBufferRange(GL_UNIFORM_BUFFER, uniforms::FRAME_BINDING, m_Stream.getBuffer(), m_Stream.getRegionOffset(), sizeof(uniforms::FrameBlock));
+}
+
+void FrameUniforms::fence()
+{
+	m_Stream.fence();
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "StreamBuffer.h"
+
+class Camera;
+class Shader;
+
+/*
+ * std140 uniform blocks shared by the mesh shaders. The structs mirror the "Frame" and "Draw"
+ * blocks declared in the shaders, vec3 members are stored as vec4 like std140 lays them out.
+ */
+namespace uniforms
+{
+
+// Binding points, 0 is taken by the bone palette (Model::BONE_PALETTE_BINDING)
+constexpr GLuint FRAME_BINDING = 1;
+constexpr GLuint DRAW_BINDING = 2;
+
+struct Lighting
+{
+	glm::vec3 Ambient = glm::vec3(0.1f);
+	glm::vec3 LightColor = glm::vec3(1.0f);
+	glm::vec3 LightDirection = glm::vec3(0.0f, 1.0f, 0.0f);
+};
+
+struct FrameBlock
+{
+	glm::mat4 ViewProjection;
+	glm::vec4 CameraPosition;
+	glm::vec4 Ambient;
+	glm::vec4 LightColor;
+	glm::vec4 LightDirection;
+};
+
+struct DrawBlock
+{
+	glm::mat4 World;
+	glm::mat4 NormalMatrix; // transpose of the inverse world matrix
+};
+
+/*
+ * Connects the Frame and Draw blocks of shader to their binding points, missing blocks are skipped
+ */
+void bindBlocks(const Shader &shader);
+
+/*
+ * Distance between consecutive draw blocks in a buffer, so every block can be bound on its own
+ */
+GLsizeiptr getDrawBlockStride();
+
+} // namespace uniforms
+
+/*
+ * Streams the frame block, written once per frame before the draws that read it
+ */
+class FrameUniforms
+{
+  public:
+	/**
+	 * Creates the stream buffer
+	 * @return 	False if the buffer could not be created
+	 */
+	bool init();
+
+	/**
+	 * Writes camera and lighting into the next region and binds it to FRAME_BINDING
+	 */
+	void update(const Camera &camera, const uniforms::Lighting &lighting);
+
+	/**
+	 * Marks the current region as in use, to be called after the frame's draws
+	 */
+	void fence();
+
+  private:
+	static constexpr unsigned int FRAMES_IN_FLIGHT = 3;
+
+	StreamBuffer m_Stream;
+};
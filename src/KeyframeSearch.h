@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cassert>
+
+/*
+ * Last keyframe index found for each key type of a single animation channel.
+ * Consecutive frames usually sample the same or the next keyframe interval,
+ * so starting the search from here makes sampling O(1) during playback.
+ */
+struct KeyframeCursor
+{
+	unsigned int Position = 0;
+	unsigned int Rotation = 0;
+	unsigned int Scaling = 0;
+};
+
+/*
+ * Finds the last keyframe before AnimationTime, i.e. the index i in [0, NumKeys - 2]
+ * for which keyTime(i) <= AnimationTime < keyTime(i + 1). Times before the first
+ * keyframe map to 0, times after the last keyframe map to NumKeys - 2.
+ *
+ * The cached interval and its successor are checked first, every other request
+ * (seeking, looping back to the start) falls back to a binary search.
+ * @param AnimationTime		Time to look up
+ * @param NumKeys			Number of keyframes, must be at least 2
+ * @param Cursor			Cached keyframe index, updated with the result
+ * @param keyTime			Callable returning the time of keyframe i as float
+ */
+template <typename KeyTime>
+inline unsigned int findKeyframe(float AnimationTime, unsigned int NumKeys, unsigned int &Cursor, KeyTime keyTime)
+{
+	assert(NumKeys > 1);
+
+	const unsigned int Last = NumKeys - 2;
+	const unsigned int Current = Cursor > Last ? Last : Cursor;
+
+	// Forward playback: still in the same interval or moved on to the next one
+	if (keyTime(Current) <= AnimationTime)
+	{
+		if (Current == Last || AnimationTime < keyTime(Current + 1))
+			return Cursor = Current;
+
+		if (Current + 1 == Last || AnimationTime < keyTime(Current + 2))
+			return Cursor = Current + 1;
+	}
+
+	// Seek or wrap-around: binary search for the first keyframe after AnimationTime
+	unsigned int Low = 1;
+	unsigned int High = NumKeys - 1;
+	while (Low < High)
+	{
+		const unsigned int Mid = Low + (High - Low) / 2;
+		if (keyTime(Mid) <= AnimationTime)
+			Low = Mid + 1;
+		else
+			High = Mid;
+	}
+
+	return Cursor = Low - 1;
+}
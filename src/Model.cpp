@@ -3,9 +3,17 @@
 #include "Model.h"
 
 #include "Camera.h"
+#include "FrameUniforms.h"
+#include "TextureCache.h"
+#include "utils/BinaryStream.h"
+#include "utils/Hash.h"
 #include "utils/Logger.h"
+#include "utils/MappedFile.h"
+#include "utils/Timer.h"
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -30,45 +38,27 @@ enum UniformLocations
 #define BONE_ID_LOCATION 3
 #define BONE_WEIGHT_LOCATION 4
 
-void ai_to_glm(const aiMatrix4x4 &from, glm::mat4 &to)
-{
-	to[0][0] = from[0][0];
-	to[0][1] = from[0][1];
-	to[0][2] = from[0][2];
-	to[0][3] = from[0][3];
-
-	to[1][0] = from[1][0];
-	to[1][1] = from[1][1];
-	to[1][2] = from[1][2];
-	to[1][3] = from[1][3];
+// Post-processing applied to every imported scene
+constexpr unsigned int IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_JoinIdenticalVertices;
 
-	to[2][0] = from[2][0];
-	to[2][1] = from[2][1];
-	to[2][2] = from[2][2];
-	to[2][3] = from[2][3];
+// Cooked models are stored next to their source with this extension
+constexpr const char *COOKED_EXTENSION = ".cooked";
+constexpr uint32_t COOKED_MAGIC = 0x4c444d41; // "AMDL"
+// Needs to be increased whenever the cooked layout or anything stored in it changes
+constexpr uint32_t COOKED_VERSION = 2;
 
-	to[3][0] = from[3][0];
-	to[3][1] = from[3][1];
-	to[3][2] = from[3][2];
-	to[3][3] = from[3][3];
-}
 
-void glm_to_ai(const glm::mat4 &from, aiMatrix4x4 &to)
-{
-	glm::mat4 newMat = glm::transpose(from);
-	for (int i = 0; i < 4; ++i)
-	{
-		for (int j = 0; j < 4; ++j)
-		{
-			to[i][j] = newMat[i][j];
-		}
-	}
-}
+const std::vector<std::string> Model::MESH_DEFINES = {"SKINNED", "TEXTURED"};
 
 Model::Model(bool normalize)
 {
 	m_Importer.SetPropertyBool(AI_CONFIG_PP_PTV_NORMALIZE, normalize);
+	m_Normalize = normalize;
 	m_VAO = 0;
+	m_SkinnedVAO = 0;
+	m_NumSkinnedVertices = 0;
+	m_SkinningMode = SkinningMode::CPU;
+	m_LoadState = LoadState::Idle;
 	memset(m_Buffers, 0, sizeof(m_Buffers));
 	m_NumBones = 0;
 	m_pScene = nullptr;
@@ -76,19 +66,17 @@ Model::Model(bool normalize)
 
 Model::~Model()
 {
+	// The worker writes into this model
+	if (m_LoadTask.valid())
+		m_LoadTask.wait();
+
 	clear();
 }
 
 void Model::clear()
 {
-	for (unsigned int i = 0; i < m_Textures.size(); i++)
-	{
-		if (m_Textures[i])
-		{
-			delete m_Textures[i];
-			m_Textures[i] = nullptr;
-		}
-	}
+	// Textures are released once no other model shares them
+	m_Textures.clear();
 
 	if (m_Buffers[0] != 0)
 	{
@@ -100,127 +88,210 @@ void Model::clear()
 		glDeleteVertexArrays(1, &m_VAO);
 		m_VAO = 0;
 	}
-}
-void getGlobalNodeTransform(aiMatrix4x4 *result, aiNode *node)
-{
-	if (node->mParent)
-	{
-		getGlobalNodeTransform(result, node->mParent);
-		aiMultiplyMatrix4(result, &node->mTransformation);
-	}
-	else
+
+	if (m_SkinnedVAO != 0)
 	{
-		*result = node->mTransformation;
+		glDeleteVertexArrays(1, &m_SkinnedVAO);
+		m_SkinnedVAO = 0;
 	}
+
+	m_SkinStream.clear();
+	m_PaletteStream.clear();
+	m_DrawStream.clear();
 }
+
 void Model::transformAllMeshes()
 {
-	//Loop through all meshes
-	for (int meshIdx = 0; meshIdx < m_pScene->mNumMeshes; ++meshIdx)
-	{
-		aiMesh *assMesh = m_pScene->mMeshes[meshIdx];
-
-		//Only skinned meshes are processed.
-		if (assMesh->mNumBones == 0)
-			continue;
+	if (m_NumSkinnedVertices == 0)
+		return;
 
-		//Create positions vector which we will pass to OpenGL
-		const auto &meshEntry = m_Entries[meshIdx];
-		const auto numVertices = m_pScene->mMeshes[meshIdx]->mNumVertices;
-		std::vector<glm::vec3> newPositions(numVertices);
-		std::vector<glm::vec3> newNormals(numVertices);
+	// Skinned vertices are written straight into the region of the stream the GPU is done with
+	glm::vec3 *pPositions = static_cast<glm::vec3 *>(m_SkinStream.map());
+	glm::vec3 *pNormals = pPositions + m_NumSkinnedVertices;
+	for (unsigned int i = 0; i < m_SkinnedMeshes.size(); i++)
+	{
+		const auto &meshEntry = m_Entries[m_SkinnedMeshes[i].Mesh];
+		m_SkinnedPositionPtrs[i] = pPositions + meshEntry.BaseVertex;
+		m_SkinnedNormalPtrs[i] = pNormals + meshEntry.BaseVertex;
+	}
 
-		//For every mesh, loop through all affected bones
-		for (int boneIdx = 0; boneIdx < assMesh->mNumBones; boneIdx++)
-		{
-			//We transform vertex positions with a 4x4 position since we can do translation
-			//But normals are only transformed using Rotation + Scale (3x3 matrix)
-			aiMatrix4x4 skin4x4;
-			aiMatrix3x3 skin3x3;
-			aiIdentityMatrix4(&skin4x4);
-			aiIdentityMatrix3(&skin3x3);
-
-			aiBone *bone = assMesh->mBones[boneIdx];
-			//Find the bone node in the hierarchy.
-			aiNode *node = m_pScene->mRootNode->FindNode(bone->mName);
-			assert(node != nullptr);
-			//Get the transformation of that bone
-			getGlobalNodeTransform(&skin4x4, node);
-			aiMultiplyMatrix4(&skin4x4, &bone->mOffsetMatrix);
-
-			//Now, for every bone we must loop through every vertex that bone affects in the mesh
-			for (int i = 0; i < bone->mNumWeights; i++)
-			{
-				int v = bone->mWeights[i].mVertexId;
-				float w = bone->mWeights[i].mWeight;
+	//Skin all meshes at once, vertex ranges of every mesh are spread over the threads
+	const auto meshCount = static_cast<unsigned int>(m_SkinnedMeshes.size());
+	skinning::skinMeshes(m_SkinnedMeshes.data(), meshCount, m_BonePalette.data(), m_SkinnedPositionPtrs.data(), m_SkinnedNormalPtrs.data());
 
-				aiVector3D aiPos = assMesh->mVertices[v];
-				aiTransformVecByMatrix4(&aiPos, &skin4x4);
+	m_SkinStream.unmap();
+	bindSkinStream();
+}
 
-				newPositions[v] += glm::vec3(aiPos.x * w, aiPos.y * w, aiPos.z * w);
+bool Model::loadMesh(const std::string &Filename)
+{
+	const bool Ret = prepareMesh(Filename) && finalizeMesh();
+	m_LoadState = Ret ? LoadState::Ready : LoadState::Failed;
+	return Ret;
+}
 
-				aiVector3D normal = assMesh->mNormals[v];
-				aiTransformVecByMatrix3(&normal, &skin3x3);
-				newNormals[v] += glm::vec3(normal.x * w, normal.y * w, normal.z * w);
-			}
-		}
-		// Finished processing all bones and vertices affected by bones of this mesh
-		// Give new position and normals to OpenGL
-		glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[POS_VB]);
-		glBufferSubData(GL_ARRAY_BUFFER, meshEntry.BaseVertex * sizeof(float) * 3, numVertices * sizeof(float) * 3, newPositions.data());
+void Model::loadMeshAsync(const std::string &Filename)
+{
+	if (m_LoadState == LoadState::Loading)
+		m_LoadTask.wait();
 
-		glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[NORMAL_VB]);
-		glBufferSubData(GL_ARRAY_BUFFER, meshEntry.BaseVertex * sizeof(float) * 3, numVertices * sizeof(float) * 3, newNormals.data());
-	}
+	// Only the worker touches the model until updateLoading() sees it finish
+	m_LoadState = LoadState::Loading;
+	m_LoadTask = std::async(std::launch::async, [this, Filename]() { return prepareMesh(Filename); });
 }
 
-bool Model::loadMesh(const std::string &Filename)
+Model::LoadState Model::updateLoading()
 {
-	clear();
+	if (m_LoadState == LoadState::Loading && m_LoadTask.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+		m_LoadState = m_LoadTask.get() && finalizeMesh() ? LoadState::Ready : LoadState::Failed;
 
-	glCreateVertexArrays(1, &m_VAO);
-	glBindVertexArray(m_VAO);
-	glCreateBuffers(sizeof(m_Buffers) / sizeof(m_Buffers[0]), m_Buffers);
+	return m_LoadState;
+}
 
+/// Loading stage without any OpenGL calls: imports the mesh and decodes its textures
+bool Model::prepareMesh(const std::string &Filename)
+{
 	bool Ret = false;
 
-	m_pScene = m_Importer.ReadFile(
-		Filename.c_str(),
-		aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_JoinIdenticalVertices);
+	// The cooked cache is only valid for the exact source file and import settings it was made from
+	const std::string CachePath = Filename + COOKED_EXTENSION;
+	const uint64_t SourceHash = hashSource(Filename);
 
-	if (m_pScene)
+	if (SourceHash != 0 && loadCache(CachePath, SourceHash))
 	{
-		Ret = initFromScene(m_pScene, Filename);
+		DEBUG("Loaded cooked model '%s'", CachePath.c_str());
+		Ret = true;
 	}
 	else
 	{
-		WARNING("Error parsing: %s, error: %s", Filename.c_str(), m_Importer.GetErrorString());
+		m_pScene = m_Importer.ReadFile(Filename.c_str(), IMPORT_FLAGS);
+
+		if (m_pScene)
+		{
+			Ret = initFromScene(m_pScene, Filename, SourceHash != 0 ? CachePath : std::string(), SourceHash);
+		}
+		else
+		{
+			WARNING("Error parsing: %s, error: %s", Filename.c_str(), m_Importer.GetErrorString());
+		}
+
+		// Nothing refers to the Assimp scene after this
+		m_Importer.FreeScene();
+		m_pScene = nullptr;
+	}
+
+	if (Ret)
+	{
+		initAnimation();
+		decodeTextures();
 	}
 
+	return Ret;
+}
+
+/// OpenGL stage of loading: replaces the GPU objects of the previous mesh with the prepared ones
+bool Model::finalizeMesh()
+{
+	clear();
+
+	m_Textures.swap(m_PendingTextures);
+	m_PendingTextures.clear();
+	for (const auto &pTexture : m_Textures)
+	{
+		if (pTexture)
+			pTexture->upload();
+	}
+
+	glCreateVertexArrays(1, &m_VAO);
+	glBindVertexArray(m_VAO);
+	glCreateBuffers(sizeof(m_Buffers) / sizeof(m_Buffers[0]), m_Buffers);
+
+	const bool Ret = initBuffers(m_PendingData);
+
 	// Make sure the VAO is not changed from the outside
 	glBindVertexArray(0);
 
+	// The vertex data lives on the GPU now
+	m_PendingStreams = VertexStreams();
+	m_PendingCache.close();
+	m_PendingData = VertexData();
+
 	return Ret;
 }
 
-bool Model::initFromScene(const aiScene *pScene, const std::string &Filename)
+/// Hashes the source file together with the import settings, returns 0 if the file cannot be read
+uint64_t Model::hashSource(const std::string &Filename) const
 {
-	m_Entries.resize(pScene->mNumMeshes);
-	m_Textures.resize(pScene->mNumMaterials);
-	m_meshTransformMatrices.resize(pScene->mNumMeshes);
-	for (auto &m : m_meshTransformMatrices)
-		m = glm::identity<glm::mat4>();
+	utils::MappedFile Source(Filename);
+	if (!Source.isOpen())
+		return 0;
+
+	const uint32_t Settings[] = {IMPORT_FLAGS, m_Normalize ? 1u : 0u};
+	const uint64_t Hash = utils::hash::fnv1a(Source.data(), Source.size());
+	return utils::hash::fnv1a(Settings, sizeof(Settings), Hash);
+}
 
-	std::vector<glm::vec3> Positions;
-	std::vector<glm::vec3> Normals;
-	std::vector<glm::vec2> TexCoords;
-	std::vector<unsigned int> Indices;
+/// Stores the depth-first index of the node referencing each mesh
+static void assignMeshNodes(const aiNode *pNode, unsigned int &NodeIndex, std::vector<int> &MeshNodes)
+{
+	const unsigned int Index = NodeIndex++;
+	for (unsigned int i = 0; i < pNode->mNumMeshes; i++)
+		MeshNodes[pNode->mMeshes[i]] = static_cast<int>(Index);
+
+	for (unsigned int i = 0; i < pNode->mNumChildren; i++)
+		assignMeshNodes(pNode->mChildren[i], NodeIndex, MeshNodes);
+}
+
+bool Model::initFromScene(const aiScene *pScene, const std::string &Filename, const std::string &CachePath, uint64_t SourceHash)
+{
+	m_Entries.assign(pScene->mNumMeshes, MeshEntry());
+	m_PendingStreams = VertexStreams();
+
+	// Flatten the node hierarchy, all per-frame transform work runs on this
+	m_Skeleton.build(pScene->mRootNode);
+	m_MeshNodes.assign(pScene->mNumMeshes, -1);
+	unsigned int NodeIndex = 0;
+	assignMeshNodes(pScene->mRootNode, NodeIndex, m_MeshNodes);
+
+	m_BoneMapping.clear();
+	m_BoneInfo.clear();
+	m_BonePalette.clear();
+	m_NumBones = 0;
+	m_SkinnedMeshes.clear();
+
+	// Compile animations into runtime clips, Assimp's animation data is not used after this
+	m_Clips.clear();
+	m_Clips.resize(pScene->mNumAnimations);
+	for (unsigned int i = 0; i < pScene->mNumAnimations; i++)
+	{
+		if (!m_Clips[i].compile(pScene->mAnimations[i], pScene->mRootNode))
+			WARNING("Animation %d of '%s' does not animate any node", i, Filename.c_str());
+	}
+
+	std::vector<glm::vec3> &Positions = m_PendingStreams.Positions;
+	std::vector<glm::vec3> &Normals = m_PendingStreams.Normals;
+	std::vector<glm::vec2> &TexCoords = m_PendingStreams.TexCoords;
+	std::vector<unsigned int> &Indices = m_PendingStreams.Indices;
 
 	unsigned int NumVertices = 0;
 	unsigned int NumIndices = 0;
 
-	// Count the number of vertices and indices
+	// Skinned meshes are stored first, so their vertices form one range that is streamed every frame
+	std::vector<unsigned int> MeshOrder;
+	MeshOrder.reserve(m_Entries.size());
+	for (unsigned int i = 0; i < m_Entries.size(); i++)
+	{
+		if (pScene->mMeshes[i]->HasBones())
+			MeshOrder.push_back(i);
+	}
 	for (unsigned int i = 0; i < m_Entries.size(); i++)
+	{
+		if (!pScene->mMeshes[i]->HasBones())
+			MeshOrder.push_back(i);
+	}
+
+	// Count the number of vertices and indices
+	for (unsigned int i : MeshOrder)
 	{
 		m_Entries[i].MaterialIndex = pScene->mMeshes[i]->mMaterialIndex;
 		m_Entries[i].NumIndices = pScene->mMeshes[i]->mNumFaces * 3;
@@ -239,46 +310,337 @@ bool Model::initFromScene(const aiScene *pScene, const std::string &Filename)
 	Indices.reserve(NumIndices);
 
 	// Initialize the meshes in the scene one by one
-	for (unsigned int i = 0; i < m_Entries.size(); i++)
+	for (unsigned int i : MeshOrder)
 	{
 		const aiMesh *paiMesh = pScene->mMeshes[i];
 		initMesh(i, paiMesh, Positions, Normals, TexCoords, Indices);
 	}
 
+	// Bone influences of skinned vertices for skinning on the GPU, other vertices have no influences
+	std::vector<glm::uvec4> &BoneIds = m_PendingStreams.BoneIds;
+	std::vector<glm::vec4> &BoneWeights = m_PendingStreams.BoneWeights;
+	BoneIds.assign(NumVertices, glm::uvec4(0));
+	BoneWeights.assign(NumVertices, glm::vec4(0.0f));
+	for (const auto &Skin : m_SkinnedMeshes)
+	{
+		const unsigned int BaseVertex = m_Entries[Skin.Mesh].BaseVertex;
+		std::copy(Skin.BoneIds.begin(), Skin.BoneIds.end(), BoneIds.begin() + BaseVertex);
+		std::copy(Skin.Weights.begin(), Skin.Weights.end(), BoneWeights.begin() + BaseVertex);
+	}
+
 	if (!initMaterials(pScene, Filename))
 	{
 		return false;
 	}
 
-	// Generate and populate the buffers with vertex attributes and the indices
+	VertexData &Data = m_PendingData;
+	Data.Positions = Positions.data();
+	Data.Normals = Normals.data();
+	Data.TexCoords = TexCoords.data();
+	Data.BoneIds = BoneIds.data();
+	Data.BoneWeights = BoneWeights.data();
+	Data.NumVertices = NumVertices;
+	Data.Indices = Indices.data();
+	Data.NumIndices = NumIndices;
+
+	if (!CachePath.empty())
+		saveCache(CachePath, SourceHash, Data);
+
+	return true;
+}
+
+/// Sets up the per-frame state that is derived from the loaded meshes, bones and clips
+void Model::initAnimation()
+{
+	m_meshTransformMatrices.assign(m_Entries.size(), glm::identity<glm::mat4>());
+	m_BonePalette.assign(m_NumBones, glm::identity<glm::mat4>());
+
+	// Keyframe cursors start at the first keyframe of every track
+	const unsigned int NumTracks = m_Clips.empty() ? 0 : m_Clips[0].getTrackCount();
+	m_KeyCursors.assign(NumTracks, KeyframeCursor());
+	m_Pose.resize(NumTracks);
+
+	// Bind every track to the skeleton node it animates, unanimated nodes keep their bind pose
+	m_TrackNodes.resize(NumTracks);
+	for (unsigned int i = 0; i < NumTracks; i++)
+		m_TrackNodes[i] = m_Clips[0].getTrack(i).Node;
+	DEBUG("Using %s pose kernel, skinning on %u threads", pose::getKernelName(pose::getKernel()), skinning::getThreadCount());
+}
+
+/// Generates and populates the buffers with vertex attributes and the indices
+bool Model::initBuffers(const VertexData &Data)
+{
 	glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[POS_VB]);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(Positions[0]) * Positions.size(), &Positions[0], GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * Data.NumVertices, Data.Positions, GL_STATIC_DRAW);
 	glEnableVertexAttribArray(UniformLocations::POSITION);
 	glVertexAttribPointer(UniformLocations::POSITION, 3, GL_FLOAT, GL_FALSE, 0, 0);
 
 	glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[TEXCOORD_VB]);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(TexCoords[0]) * TexCoords.size(), &TexCoords[0], GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec2) * Data.NumVertices, Data.TexCoords, GL_STATIC_DRAW);
 	glEnableVertexAttribArray(UniformLocations::TEXCOORD);
 	glVertexAttribPointer(UniformLocations::TEXCOORD, 2, GL_FLOAT, GL_FALSE, 0, 0);
 
 	glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[NORMAL_VB]);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(Normals[0]) * Normals.size(), &Normals[0], GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * Data.NumVertices, Data.Normals, GL_STATIC_DRAW);
 	glEnableVertexAttribArray(UniformLocations::NORMAL);
 	glVertexAttribPointer(UniformLocations::NORMAL, 3, GL_FLOAT, GL_FALSE, 0, 0);
 
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_Buffers[INDEX_BUFFER]);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(Indices[0]) * Indices.size(), &Indices[0], GL_STATIC_DRAW);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * Data.NumIndices, Data.Indices, GL_STATIC_DRAW);
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[BONE_ID_VB]);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(glm::uvec4) * Data.NumVertices, Data.BoneIds, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(UniformLocations::BONE_ID);
+	glVertexAttribIPointer(UniformLocations::BONE_ID, 4, GL_UNSIGNED_INT, 0, 0);
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[BONE_WEIGHT_VB]);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec4) * Data.NumVertices, Data.BoneWeights, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(UniformLocations::BONE_WEIGHT);
+	glVertexAttribPointer(UniformLocations::BONE_WEIGHT, 4, GL_FLOAT, GL_FALSE, 0, 0);
+
+	if (!initSkinningBuffers(Data.Positions, Data.Normals))
+	{
+		return false;
+	}
+
+	// One draw block per entry, each aligned so it can be bound on its own
+	const size_t NumDraws = std::max<size_t>(m_Entries.size(), 1);
+	if (!m_DrawStream.init(uniforms::getDrawBlockStride() * NumDraws, SKINNING_FRAMES_IN_FLIGHT))
+	{
+		return false;
+	}
+
+	return glGetError() == GL_NO_ERROR;
+}
+
+/// Mesh entries are stored field by field, so padding and the size of bool do not end up in the cache
+void Model::MeshEntry::write(utils::BinaryWriter &Writer) const
+{
+	Writer.write<uint32_t>(NumIndices);
+	Writer.write<uint32_t>(NumVertices);
+	Writer.write<uint32_t>(BaseVertex);
+	Writer.write<uint32_t>(BaseIndex);
+	Writer.write<uint32_t>(MaterialIndex);
+	Writer.write<uint8_t>(Skinned ? 1 : 0);
+}
+
+void Model::MeshEntry::read(utils::BinaryReader &Reader)
+{
+	NumIndices = Reader.read<uint32_t>();
+	NumVertices = Reader.read<uint32_t>();
+	BaseVertex = Reader.read<uint32_t>();
+	BaseIndex = Reader.read<uint32_t>();
+	MaterialIndex = Reader.read<uint32_t>();
+	Skinned = Reader.read<uint8_t>() != 0;
+}
+
+/// Writes everything initFromScene produced to the cooked cache
+void Model::saveCache(const std::string &CachePath, uint64_t SourceHash, const VertexData &Data) const
+{
+	utils::BinaryWriter Writer;
+	Writer.write(COOKED_MAGIC);
+	Writer.write(COOKED_VERSION);
+	Writer.write(SourceHash);
+
+	Writer.write<uint32_t>(static_cast<uint32_t>(m_Entries.size()));
+	for (const auto &Entry : m_Entries)
+		Entry.write(Writer);
+	Writer.writeArray(m_MeshNodes);
+	Writer.write<uint32_t>(static_cast<uint32_t>(m_TexturePaths.size()));
+	for (const auto &Path : m_TexturePaths)
+		Writer.writeString(Path);
+
+	m_Skeleton.write(Writer);
+
+	Writer.writeArray(m_BoneInfo);
+	Writer.write<uint32_t>(static_cast<uint32_t>(m_BoneMapping.size()));
+	for (const auto &Mapping : m_BoneMapping)
+	{
+		Writer.writeString(Mapping.first);
+		Writer.write<uint32_t>(Mapping.second);
+	}
+
+	Writer.write<uint32_t>(static_cast<uint32_t>(m_SkinnedMeshes.size()));
+	for (const auto &Skin : m_SkinnedMeshes)
+		Skin.write(Writer);
+
+	Writer.write<uint32_t>(static_cast<uint32_t>(m_Clips.size()));
+	for (const auto &Clip : m_Clips)
+		Clip.write(Writer);
+
+	Writer.writeArray(Data.Positions, Data.NumVertices);
+	Writer.writeArray(Data.Normals, Data.NumVertices);
+	Writer.writeArray(Data.TexCoords, Data.NumVertices);
+	Writer.writeArray(Data.BoneIds, Data.NumVertices);
+	Writer.writeArray(Data.BoneWeights, Data.NumVertices);
+	Writer.writeArray(Data.Indices, Data.NumIndices);
+
+	if (!Writer.save(CachePath))
+		WARNING("Could not write cooked model '%s'", CachePath.c_str());
+}
+
+/// Restores the model from the cooked cache, returns false if it is missing, stale or invalid
+bool Model::loadCache(const std::string &CachePath, uint64_t SourceHash)
+{
+	// The mapping stays open until the data is uploaded
+	utils::MappedFile &Cache = m_PendingCache;
+	if (!Cache.open(CachePath))
+		return false;
+
+	utils::BinaryReader Reader(Cache.data(), Cache.size());
+	if (Reader.read<uint32_t>() != COOKED_MAGIC || Reader.read<uint32_t>() != COOKED_VERSION || Reader.read<uint64_t>() != SourceHash)
+	{
+		DEBUG("Cooked model '%s' is outdated", CachePath.c_str());
+		Cache.close();
+		return false;
+	}
+
+	m_Entries.resize(Reader.readCount(MeshEntry::SERIALIZED_SIZE));
+	for (auto &Entry : m_Entries)
+		Entry.read(Reader);
+	Reader.readArray(m_MeshNodes);
+	// Every path, skinned mesh and clip starts with a 64-bit size, which bounds how many the data can hold
+	m_TexturePaths.resize(Reader.readCount(sizeof(uint64_t)));
+	for (auto &Path : m_TexturePaths)
+		Path = Reader.readString();
+
+	bool Valid = m_Skeleton.read(Reader);
+
+	Reader.readArray(m_BoneInfo);
+	m_NumBones = static_cast<unsigned int>(m_BoneInfo.size());
+	m_BoneMapping.clear();
+	const uint32_t NumMappings = Reader.read<uint32_t>();
+	for (uint32_t i = 0; i < NumMappings && Reader.ok(); i++)
+	{
+		const std::string Name = Reader.readString();
+		m_BoneMapping[Name] = Reader.read<uint32_t>();
+	}
+
+	m_SkinnedMeshes.resize(Reader.readCount(sizeof(uint64_t)));
+	for (auto &Skin : m_SkinnedMeshes)
+		Valid = Valid && Skin.read(Reader);
+
+	m_Clips.resize(Reader.readCount(sizeof(uint64_t)));
+	for (auto &Clip : m_Clips)
+		Valid = Valid && Clip.read(Reader);
+
+	// Vertex and index data is uploaded straight from the mapping
+	size_t NumVertices[5];
+	size_t NumIndices = 0;
+	VertexData &Data = m_PendingData;
+	Data.Positions = Reader.viewArray<glm::vec3>(NumVertices[0]);
+	Data.Normals = Reader.viewArray<glm::vec3>(NumVertices[1]);
+	Data.TexCoords = Reader.viewArray<glm::vec2>(NumVertices[2]);
+	Data.BoneIds = Reader.viewArray<glm::uvec4>(NumVertices[3]);
+	Data.BoneWeights = Reader.viewArray<glm::vec4>(NumVertices[4]);
+	Data.Indices = Reader.viewArray<unsigned int>(NumIndices);
+	Data.NumVertices = static_cast<unsigned int>(NumVertices[0]);
+	Data.NumIndices = static_cast<unsigned int>(NumIndices);
+
+	Valid = Valid && Reader.ok() && validateCache(Data);
+	for (unsigned int i = 1; i < 5; i++)
+		Valid = Valid && NumVertices[i] == NumVertices[0];
+
+	if (!Valid)
+	{
+		WARNING("Cooked model '%s' is corrupt, loading the source instead", CachePath.c_str());
+		Cache.close();
+		Data = VertexData();
+		return false;
+	}
+
+	return true;
+}
+
+/// Checks that all indices stored in the cache are in range
+bool Model::validateCache(const VertexData &Data) const
+{
+	const unsigned int NumNodes = m_Skeleton.getNodeCount();
+	if (m_MeshNodes.size() != m_Entries.size())
+		return false;
+
+	uint64_t NumSkinnedVertices = 0;
+	for (unsigned int i = 0; i < m_Entries.size(); i++)
+	{
+		const MeshEntry &Entry = m_Entries[i];
+		if (Entry.BaseVertex > Data.NumVertices || Entry.NumVertices > Data.NumVertices - Entry.BaseVertex ||
+			Entry.BaseIndex > Data.NumIndices || Entry.NumIndices > Data.NumIndices - Entry.BaseIndex)
+			return false;
+		if (Entry.MaterialIndex >= m_TexturePaths.size() || m_MeshNodes[i] >= static_cast<int>(NumNodes))
+			return false;
+		if (Entry.Skinned)
+			NumSkinnedVertices += Entry.NumVertices;
+	}
 
-	return static_cast<bool>(glGetError());
+	for (const auto &Info : m_BoneInfo)
+	{
+		if (Info.Node < 0 || Info.Node >= static_cast<int>(NumNodes))
+			return false;
+	}
+
+	// Skinned meshes need to occupy the first vertices, in order
+	uint64_t BaseVertex = 0;
+	for (const auto &Skin : m_SkinnedMeshes)
+	{
+		if (Skin.Mesh >= m_Entries.size() || !m_Entries[Skin.Mesh].Skinned || m_Entries[Skin.Mesh].BaseVertex != BaseVertex || m_Entries[Skin.Mesh].NumVertices != Skin.NumVertices)
+			return false;
+		for (const auto &Ids : Skin.BoneIds)
+		{
+			if (glm::any(glm::greaterThanEqual(Ids, glm::uvec4(m_NumBones))))
+				return false;
+		}
+		BaseVertex += Skin.NumVertices;
+	}
+	if (BaseVertex != NumSkinnedVertices)
+		return false;
+
+	for (unsigned int i = 0; i < Data.NumIndices; i++)
+	{
+		if (Data.Indices[i] >= Data.NumVertices)
+			return false;
+	}
+
+	for (const auto &Clip : m_Clips)
+	{
+		for (unsigned int i = 0; i < Clip.getTrackCount(); i++)
+		{
+			if (Clip.getTrack(i).Node >= NumNodes)
+				return false;
+		}
+	}
+
+	return true;
 }
 
 void Model::initMesh(unsigned int MeshIndex, const aiMesh *paiMesh, std::vector<glm::vec3> &Positions, std::vector<glm::vec3> &Normals, std::vector<glm::vec2> &TexCoords, std::vector<unsigned int> &Indices)
 {
 	const aiVector3D Zero3D(0.0f, 0.0f, 0.0f);
 
+	// Order[n] is the Assimp index of the n-th vertex we store
+	std::vector<unsigned int> Order;
+
+	if (paiMesh->HasBones())
+	{
+		// Skinned vertices are sorted by their number of bone influences
+		m_SkinnedMeshes.emplace_back();
+		m_SkinnedMeshes.back().Mesh = MeshIndex;
+		skinning::buildInfluences(paiMesh, loadBones(paiMesh), m_SkinnedMeshes.back(), Order);
+		m_Entries[MeshIndex].Skinned = true;
+	}
+	else
+	{
+		Order.resize(paiMesh->mNumVertices);
+		for (unsigned int i = 0; i < paiMesh->mNumVertices; i++)
+			Order[i] = i;
+	}
+
 	// Populate the vertex attribute std::vectors
-	for (unsigned int i = 0; i < paiMesh->mNumVertices; i++)
+	std::vector<unsigned int> Remap(paiMesh->mNumVertices);
+	for (unsigned int n = 0; n < paiMesh->mNumVertices; n++)
 	{
+		const unsigned int i = Order[n];
+		Remap[i] = n;
+
 		const aiVector3D *pPos = &(paiMesh->mVertices[i]);
 		const aiVector3D *pNormal = &(paiMesh->mNormals[i]);
 		const aiVector3D *pTexCoord = paiMesh->HasTextureCoords(0) ? &(paiMesh->mTextureCoords[0][i]) : &Zero3D;
@@ -288,100 +650,151 @@ void Model::initMesh(unsigned int MeshIndex, const aiMesh *paiMesh, std::vector<
 		TexCoords.push_back(glm::vec2(pTexCoord->x, pTexCoord->y));
 	}
 
-	//LoadBones(MeshIndex, paiMesh, Bones);
-
 	// Populate the index buffer
 	for (unsigned int i = 0; i < paiMesh->mNumFaces; i++)
 	{
 		const aiFace &Face = paiMesh->mFaces[i];
 		assert(Face.mNumIndices == 3);
-		Indices.push_back(Face.mIndices[0]);
-		Indices.push_back(Face.mIndices[1]);
-		Indices.push_back(Face.mIndices[2]);
+		Indices.push_back(Remap[Face.mIndices[0]]);
+		Indices.push_back(Remap[Face.mIndices[1]]);
+		Indices.push_back(Remap[Face.mIndices[2]]);
 	}
 }
 
-/// Iterates through the node hierarchy till it finds the named node
-std::tuple<aiNode *, glm::mat4> getNodeByName(std::string nodeName, glm::mat4 parentTransform, aiNode *parent)
+/// Registers the bones of a mesh and links them to their skeleton node, returns their palette indices
+std::vector<unsigned int> Model::loadBones(const aiMesh *paiMesh)
 {
-	if (parent->mName.C_Str() == nodeName) return std::make_tuple(parent, parentTransform);
+	std::vector<unsigned int> MeshBones(paiMesh->mNumBones);
 
-	for (int i = 0; i < parent->mNumChildren; i++)
+	for (unsigned int i = 0; i < paiMesh->mNumBones; i++)
 	{
-		aiNode *child = parent->mChildren[i];
-
-		glm::mat4 transform;
-		ai_to_glm(child->mTransformation, transform);
+		const aiBone *pBone = paiMesh->mBones[i];
+		const std::string BoneName(pBone->mName.data);
 
-		transform = transform * parentTransform;
-
-		auto foundInChildren = getNodeByName(nodeName, transform, child);
+		const auto Mapping = m_BoneMapping.find(BoneName);
+		if (Mapping != m_BoneMapping.end())
+		{
+			MeshBones[i] = Mapping->second;
+			continue;
+		}
 
-		bool found = std::get<0>(foundInChildren);
+		BoneInfo Info;
+		Info.BoneOffset = toGlm(pBone->mOffsetMatrix);
+		Info.Node = m_Skeleton.findNode(BoneName);
+		if (Info.Node < 0)
+		{
+			WARNING("Bone '%s' has no node in the hierarchy", BoneName.c_str());
+			Info.Node = 0;
+		}
 
-		if (found) return foundInChildren;
+		m_BoneInfo.push_back(Info);
+		m_BoneMapping[BoneName] = m_NumBones;
+		MeshBones[i] = m_NumBones++;
 	}
 
-	return std::make_tuple(nullptr, parentTransform);
+	m_BonePalette.resize(m_NumBones);
+	return MeshBones;
 }
 
-glm::vec3 transformToPosition(aiMatrix4x4 aiTransform)
+/// Creates the stream skinned vertices are written to every frame and the VAO drawing from it
+bool Model::initSkinningBuffers(const glm::vec3 *Positions, const glm::vec3 *Normals)
 {
-	glm::mat4 transform;
-
-	ai_to_glm(aiTransform, transform);
-
-	auto result = glm::vec4(0, 0, 0, 1) * transform;
-
-	return (glm::vec3)result;
-}
+	// Skinned meshes are stored first, so their vertices are [0, m_NumSkinnedVertices)
+	m_NumSkinnedVertices = 0;
+	for (const auto &Skin : m_SkinnedMeshes)
+		m_NumSkinnedVertices += Skin.NumVertices;
+
+	m_SkinnedPositionPtrs.resize(m_SkinnedMeshes.size());
+	m_SkinnedNormalPtrs.resize(m_SkinnedMeshes.size());
+	if (m_NumSkinnedVertices == 0)
+		return true;
+
+	// Every region holds the positions of all skinned vertices followed by their normals
+	const GLsizeiptr BlockSize = sizeof(glm::vec3) * m_NumSkinnedVertices;
+	if (!m_SkinStream.init(2 * BlockSize, SKINNING_FRAMES_IN_FLIGHT))
+		return false;
 
-/// Finds all the bones recursively and also applies the transform
-void findBonesRecursive(aiNode *parent, glm::mat4 parentTransform, std::vector<std::string> boneNames, std::vector<std::tuple<std::string, glm::vec3, glm::vec3>> *bones)
-{
-	glm::vec3 parentPosition = glm::vec4(0, 0, 0, 1) * parentTransform;
+	// The bone palette is streamed the same way when skinning on the GPU
+	if (!m_PaletteStream.init(sizeof(glm::mat4) * MAX_BONES, SKINNING_FRAMES_IN_FLIGHT))
+		return false;
 
-	for (int i = 0; i < parent->mNumChildren; i++)
+	if (m_NumBones > MAX_BONES)
 	{
-		aiNode *child = parent->mChildren[i];
-
-		glm::mat4 transform;
-		ai_to_glm(child->mTransformation, transform);
-
-		transform = transform * parentTransform;
-
-		glm::vec3 childPosition = glm::vec4(0, 0, 0, 1) * transform;
+		WARNING("Model has %u bones, skinning on the GPU supports up to %u", m_NumBones, MAX_BONES);
+		m_SkinningMode = SkinningMode::CPU;
+	}
 
-		bones->push_back(std::tuple<std::string, glm::vec3, glm::vec3>(child->mName.C_Str(), parentPosition, childPosition));
+	// Start every region in the rest pose, so drawing before the first update is valid
+	for (unsigned int i = 0; i < SKINNING_FRAMES_IN_FLIGHT; i++)
+	{
+		char *pRegion = static_cast<char *>(m_SkinStream.map());
+		memcpy(pRegion, Positions, BlockSize);
+		memcpy(pRegion + BlockSize, Normals, BlockSize);
+		m_SkinStream.unmap();
+		m_SkinStream.fence();
+
+		// Models without clips never update the palette, the rest pose keeps them drawable on the GPU
+		const unsigned int NumPaletteBones = std::min<unsigned int>(static_cast<unsigned int>(m_BonePalette.size()), MAX_BONES);
+		glm::mat4 *pPalette = static_cast<glm::mat4 *>(m_PaletteStream.map());
+		std::copy(m_BonePalette.begin(), m_BonePalette.begin() + NumPaletteBones, pPalette);
+		std::fill(pPalette + NumPaletteBones, pPalette + MAX_BONES, glm::identity<glm::mat4>());
+		m_PaletteStream.unmap();
+		m_PaletteStream.fence();
+	}
 
-		findBonesRecursive(child, transform, boneNames, bones); // Recursively iterate over children
+	glCreateVertexArrays(1, &m_SkinnedVAO);
+	const GLuint Attributes[] = {UniformLocations::POSITION, UniformLocations::NORMAL, UniformLocations::TEXCOORD};
+	for (GLuint Attribute : Attributes)
+	{
+		glEnableVertexArrayAttrib(m_SkinnedVAO, Attribute);
+		glVertexArrayAttribFormat(m_SkinnedVAO, Attribute, Attribute == UniformLocations::TEXCOORD ? 2 : 3, GL_FLOAT, GL_FALSE, 0);
+		glVertexArrayAttribBinding(m_SkinnedVAO, Attribute, Attribute);
 	}
+	glVertexArrayVertexBuffer(m_SkinnedVAO, UniformLocations::TEXCOORD, m_Buffers[TEXCOORD_VB], 0, sizeof(glm::vec2));
+	glVertexArrayElementBuffer(m_SkinnedVAO, m_Buffers[INDEX_BUFFER]);
+	bindSkinStream();
+
+	return true;
 }
 
-/// Returns the bones with the transform applied
-std::vector<std::tuple<std::string, glm::vec3, glm::vec3>> Model::getSkeletalRig(std::string rootNodeName)
+/// Points the skinned VAO at the current region of the skinning stream
+void Model::bindSkinStream()
 {
-	auto identity = glm::identity<glm::mat4>();
-
-	std::tuple<aiNode *, glm::mat4> foundNode = getNodeByName(rootNodeName, identity, m_pScene->mRootNode);
-
-	aiNode *skeletalRoot;
-	glm::mat4 rootTransform;
-	std::tie(skeletalRoot, rootTransform) = foundNode;
+	const GLintptr Offset = m_SkinStream.getRegionOffset();
+	glVertexArrayVertexBuffer(m_SkinnedVAO, UniformLocations::POSITION, m_SkinStream.getBuffer(), Offset, sizeof(glm::vec3));
+	glVertexArrayVertexBuffer(m_SkinnedVAO, UniformLocations::NORMAL, m_SkinStream.getBuffer(), Offset + sizeof(glm::vec3) * m_NumSkinnedVertices, sizeof(glm::vec3));
+}
 
-	std::vector<std::tuple<std::string, glm::vec3, glm::vec3>> bones;
+int Model::findNode(const std::string &Name) const
+{
+	return m_Skeleton.findNode(Name);
+}
 
-	std::vector<std::string> boneNames;
+/// Fills Bones with the bones below RootNode, with the transform applied
+unsigned int Model::getSkeletalRig(int RootNode, std::vector<RigBone> &Bones) const
+{
+	// Clearing keeps the capacity, so a reused vector is not reallocated
+	Bones.clear();
+	if (m_LoadState == LoadState::Loading || RootNode < 0 || RootNode >= static_cast<int>(m_Skeleton.getNodeCount()))
+		return 0;
 
-	for (const auto &map : m_BoneMapping)
-		boneNames.push_back(map.first);
+	// Positions are relative to the scene's root node
+	const glm::mat4 InverseSceneRoot = glm::inverse(m_Skeleton.getGlobalTransform(0));
 
-	findBonesRecursive(skeletalRoot, rootTransform, boneNames, &bones);
+	// Descendants of the rig's root are stored right after it
+	for (unsigned int i = RootNode + 1; i < m_Skeleton.getSubtreeEnd(RootNode); i++)
+	{
+		RigBone Bone;
+		Bone.Node = i;
+		Bone.Start = (InverseSceneRoot * m_Skeleton.getGlobalTransform(m_Skeleton.getParent(i)))[3];
+		Bone.End = (InverseSceneRoot * m_Skeleton.getGlobalTransform(i))[3];
+		Bones.push_back(Bone);
+	}
 
-	return bones;
+	return static_cast<unsigned int>(Bones.size());
 }
 
-/// Finds and creates the textures
+/// Finds the textures of all materials and creates them
 bool Model::initMaterials(const aiScene *pScene, const std::string &Filename)
 {
 	// Extract the directory part from the file name
@@ -401,15 +814,12 @@ bool Model::initMaterials(const aiScene *pScene, const std::string &Filename)
 		Dir = Filename.substr(0, SlashIndex);
 	}
 
-	bool Ret = true;
-
-	// Initialize the materials
+	// Initialize the materials, materials without a diffuse texture keep an empty path
+	m_TexturePaths.assign(pScene->mNumMaterials, std::string());
 	for (unsigned int i = 0; i < pScene->mNumMaterials; i++)
 	{
 		const aiMaterial *pMaterial = pScene->mMaterials[i];
 
-		m_Textures[i] = NULL;
-
 		if (pMaterial->GetTextureCount(aiTextureType_DIFFUSE) > 0)
 		{
 			aiString Path;
@@ -423,44 +833,78 @@ bool Model::initMaterials(const aiScene *pScene, const std::string &Filename)
 					p = p.substr(2, p.size() - 2);
 				}
 
-				std::string FullPath = Dir + "/" + p;
-
-				m_Textures[i] = new Texture(GL_TEXTURE_2D, FullPath.c_str());
-
-				if (!m_Textures[i]->load())
-					WARNING("Error loading texture '%s'", FullPath.c_str());
-				else
-					DEBUG("%d - loaded texture '%s'", i, FullPath.c_str());
+				m_TexturePaths[i] = Dir + "/" + p;
 			}
 		}
 	}
 
-	return Ret;
+	return true;
 }
 
-void Model::render(Shader &shader, Camera &camera)
+/// Looks up the textures of all materials in the shared cache, decoding new ones. Uploading happens in finalizeMesh
+void Model::decodeTextures()
+{
+	m_PendingTextures.assign(m_TexturePaths.size(), nullptr);
+	for (unsigned int i = 0; i < m_TexturePaths.size(); i++)
+	{
+		if (!m_TexturePaths[i].empty())
+			m_PendingTextures[i] = textures::acquire(m_TexturePaths[i]);
+	}
+}
+
+void Model::render(ShaderVariants &meshShaders)
 {
 	using namespace glm;
-	glBindVertexArray(m_VAO);
+	// The draw stream only exists once loading succeeded
+	if (m_LoadState != LoadState::Ready)
+		return;
+
+	const bool SkinOnGpu = m_SkinningMode == SkinningMode::GPU && m_NumSkinnedVertices > 0;
+	if (SkinOnGpu)
+	{
+		const GLintptr Offset = m_PaletteStream.getRegionOffset();
+		glBindBufferRange(GL_UNIFORM_BUFFER, BONE_PALETTE_BINDING, m_PaletteStream.getBuffer(), Offset, m_PaletteStream.getRegionSize());
+	}
+
+	// Write the draw blocks of all entries at once, the draws below only bind their range
+	const GLsizeiptr Stride = uniforms::getDrawBlockStride();
+	const auto modifyModel = rotate(translate(mat4(1.0f), vec3(0, 2, 0)), radians(180.0f), vec3(0, 0, 1));
+	char *pDraws = static_cast<char *>(m_DrawStream.map());
+	for (size_t i = 0; i < m_Entries.size(); ++i)
+	{
+		auto *pBlock = reinterpret_cast<uniforms::DrawBlock *>(pDraws + Stride * i);
+		pBlock->World = modifyModel * m_meshTransformMatrices[i];
+		pBlock->NormalMatrix = transpose(inverse(pBlock->World));
+	}
+	m_DrawStream.unmap();
+	const GLintptr DrawOffset = m_DrawStream.getRegionOffset();
 
+	const Shader *pBound = nullptr;
 	for (int i = 0; i < m_Entries.size(); ++i)
 	{
 		const auto &entry = m_Entries[i];
 
-		const auto modifyModel = rotate(translate(mat4(1.0f), vec3(0, 2, 0)), radians(180.0f), vec3(0, 0, 1));
-		auto model = glm::transpose(m_meshTransformMatrices[i]) * glm::mat4(1.0f);
-		model = modifyModel * model;
+		assert(entry.MaterialIndex < m_Textures.size());
+		const auto &texture = m_Textures[entry.MaterialIndex];
 
-		const auto matrix = camera.getCombinedMatrix(model);
+		// Skinned meshes either read their vertices from the skinning stream or are skinned by the vertex shader
+		uint32_t variant = texture ? MESH_TEXTURED : 0;
+		if (entry.Skinned && SkinOnGpu)
+			variant |= MESH_SKINNED;
 
-		shader.setUniformFloat("gWorld", inverse(model), true);
-		shader.setUniformFloat("MVP", matrix);
-		shader.setUniformInt("texture0", 0);
+		Shader &entryShader = meshShaders.get(variant);
+		if (pBound != &entryShader)
+		{
+			entryShader.bind();
+			pBound = &entryShader;
+		}
 
-		assert(entry.MaterialIndex < m_Textures.size());
+		glBindBufferRange(GL_UNIFORM_BUFFER, uniforms::DRAW_BINDING, m_DrawStream.getBuffer(), DrawOffset + Stride * i, sizeof(uniforms::DrawBlock));
+
+		glBindVertexArray(entry.Skinned && !SkinOnGpu ? m_SkinnedVAO : m_VAO);
 
-		if (m_Textures[entry.MaterialIndex])
-			m_Textures[entry.MaterialIndex]->bind(GL_TEXTURE0);
+		if (texture)
+			texture->bind(GL_TEXTURE0);
 
 		glDrawElementsBaseVertex(GL_TRIANGLES,
 								 entry.NumIndices,
@@ -470,194 +914,91 @@ void Model::render(Shader &shader, Camera &camera)
 	}
 
 	glBindVertexArray(0);
-}
-
-/// Finds the last keyframe before AnimationTime
-unsigned int Model::findPosition(float AnimationTime, const aiNodeAnim *pNodeAnim)
-{
-	for (unsigned int i = 0; i < pNodeAnim->mNumPositionKeys - 1; i++)
-	{
-		if (AnimationTime < (float)pNodeAnim->mPositionKeys[i + 1].mTime)
-		{
-			return i;
-		}
-	}
-
-	return 0;
-}
-
-/// Finds the last keyframe before AnimationTime
-unsigned int Model::findRotation(float AnimationTime, const aiNodeAnim *pNodeAnim)
-{
-	assert(pNodeAnim->mNumRotationKeys > 0);
-
-	for (unsigned int i = 0; i < pNodeAnim->mNumRotationKeys - 1; i++)
-	{
-		if (AnimationTime < (float)pNodeAnim->mRotationKeys[i + 1].mTime)
-		{
-			return i;
-		}
-	}
-
-	return 0;
-}
-
-/// Finds the last keyframe before AnimationTime
-unsigned int Model::findScaling(float AnimationTime, const aiNodeAnim *pNodeAnim)
-{
-	assert(pNodeAnim->mNumScalingKeys > 0);
-
-	for (unsigned int i = 0; i < pNodeAnim->mNumScalingKeys - 1; i++)
-	{
-		if (AnimationTime < (float)pNodeAnim->mScalingKeys[i + 1].mTime)
-		{
-			return i;
-		}
-	}
 
-	return 0;
+	// The GPU reads the current stream regions until these draws complete
+	m_DrawStream.fence();
+	if (SkinOnGpu)
+		m_PaletteStream.fence();
+	else if (m_NumSkinnedVertices > 0)
+		m_SkinStream.fence();
 }
 
-/// Linearly interpolate from last animation position to current one, based on  keyframe time of animations
-glm::vec3 Model::calcInterpolatedPosition(float AnimationTime, const aiNodeAnim *pNodeAnim)
+bool Model::setSkinningMode(SkinningMode Mode)
 {
-	// If there is only one keyframe then we don't interpolate
-	if (pNodeAnim->mNumPositionKeys == 1)
-	{
-		return glm::make_vec3((float *)&pNodeAnim->mPositionKeys[0].mValue);
-	}
-
-	unsigned int PositionIndex = findPosition(AnimationTime, pNodeAnim);
-	unsigned int NextPositionIndex = (PositionIndex + 1);
-	assert(NextPositionIndex < pNodeAnim->mNumPositionKeys);
-	// Scaling based on % of time elapsed between the two keyframes
-	float DeltaTime = (float)(pNodeAnim->mPositionKeys[NextPositionIndex].mTime - pNodeAnim->mPositionKeys[PositionIndex].mTime);
-	float Factor = (AnimationTime - (float)pNodeAnim->mPositionKeys[PositionIndex].mTime) / DeltaTime;
-
-	const aiVector3D &Start = pNodeAnim->mPositionKeys[PositionIndex].mValue;
-	const aiVector3D &End = pNodeAnim->mPositionKeys[NextPositionIndex].mValue;
+	if (Mode == SkinningMode::GPU && m_NumBones > MAX_BONES)
+		return false;
 
-	aiVector3D Delta = Start + Factor * (End - Start);
-	return glm::make_vec3((float *)&Delta);
+	m_SkinningMode = Mode;
+	return true;
 }
 
-/// Spherically interpolates between quaternion rotations
-void Model::calcInterpolatedRotation(aiQuaternion &Out, float AnimationTime, const aiNodeAnim *pNodeAnim)
+void Model::bindBonePalette(const Shader &shader)
 {
-	// If there is only one keyframe then we don't interpolate
-	if (pNodeAnim->mNumRotationKeys == 1)
+	const GLuint Program = shader.getShaderId();
+	const GLuint Block = glGetUniformBlockIndex(Program, "BonePalette");
+	if (Block == GL_INVALID_INDEX)
 	{
-		Out = pNodeAnim->mRotationKeys[0].mValue;
+		WARNING("Shader %u has no BonePalette block", Program);
 		return;
 	}
 
-	unsigned int RotationIndex = findRotation(AnimationTime, pNodeAnim);
-	unsigned int NextRotationIndex = (RotationIndex + 1);
-	assert(NextRotationIndex < pNodeAnim->mNumRotationKeys);
-	// Scaling based on % of time elapsed between the two keyframes
-	float DeltaTime = (float)(pNodeAnim->mRotationKeys[NextRotationIndex].mTime - pNodeAnim->mRotationKeys[RotationIndex].mTime);
-	float Factor = (AnimationTime - (float)pNodeAnim->mRotationKeys[RotationIndex].mTime) / DeltaTime;
-
-	const aiQuaternion &StartRotationQ = pNodeAnim->mRotationKeys[RotationIndex].mValue;
-	const aiQuaternion &EndRotationQ = pNodeAnim->mRotationKeys[NextRotationIndex].mValue;
-	aiQuaternion::Interpolate(Out, StartRotationQ, EndRotationQ, Factor);
-	Out = Out.Normalize();
+	glUniformBlockBinding(Program, Block, BONE_PALETTE_BINDING);
 }
 
-/// Linearly interpolate from last animation scale to current one, based on  keyframe time of animations
-glm::vec3 Model::calcInterpolatedScaling(float AnimationTime, const aiNodeAnim *pNodeAnim)
+/// Uploads the bone palette for skinning on the GPU
+void Model::uploadBonePalette()
 {
-	// If there is only one keyframe then we don't interpolate
-	if (pNodeAnim->mNumScalingKeys == 1)
-	{
-		return glm::make_vec3((float *)&pNodeAnim->mScalingKeys[0].mValue);
-	}
-
-	unsigned int ScalingIndex = findScaling(AnimationTime, pNodeAnim);
-	unsigned int NextScalingIndex = (ScalingIndex + 1);
-	assert(NextScalingIndex < pNodeAnim->mNumScalingKeys);
-	// Scaling based on % of time elapsed between the two keyframes
-	float DeltaTime = (float)(pNodeAnim->mScalingKeys[NextScalingIndex].mTime - pNodeAnim->mScalingKeys[ScalingIndex].mTime);
-	float Factor = (AnimationTime - (float)pNodeAnim->mScalingKeys[ScalingIndex].mTime) / DeltaTime;
-	
-	const aiVector3D &Start = pNodeAnim->mScalingKeys[ScalingIndex].mValue;
-	const aiVector3D &End = pNodeAnim->mScalingKeys[NextScalingIndex].mValue;
-	aiVector3D Delta = Start + Factor * (End - Start);
+	if (m_NumSkinnedVertices == 0)
+		return;
 
-	return glm::make_vec3((float *)&Delta);
+	void *pRegion = m_PaletteStream.map();
+	memcpy(pRegion, m_BonePalette.data(), sizeof(glm::mat4) * m_NumBones);
+	m_PaletteStream.unmap();
 }
 
-void Model::readNodeHierarchy(float AnimationTime, aiNode *pNode, aiMatrix4x4 worldTransform)
+void Model::updatePose()
 {
-	const std::string NodeName(pNode->mName.data);
-
-	const aiAnimation *pAnimation = m_pScene->mAnimations[0];
-
-	aiMultiplyMatrix4(&worldTransform, &pNode->mTransformation);
-
-	for (int i = 0; i < pNode->mNumMeshes; i++)
-	{
-		if (m_pScene->mMeshes[pNode->mMeshes[i]]->mNumBones == 0)
-		{
-			ai_to_glm(worldTransform, m_meshTransformMatrices[pNode->mMeshes[i]]);
-		}
-	}
-
-	//Enable animation
-#if 1
-	const aiNodeAnim *pNodeAnim = findNodeAnim(pAnimation, NodeName);
-
-	if (pNodeAnim)
-	{
-		aiQuaternion RotationKey;
-		calcInterpolatedRotation(RotationKey, AnimationTime, pNodeAnim);
+	// Animated nodes get their local transform from the sampled track, all others keep their bind pose
+	pose::composeMatrices(m_Pose, m_TrackNodes.data(), m_Skeleton.getLocalTransforms());
 
-		glm::vec3 t = calcInterpolatedPosition(AnimationTime, pNodeAnim);
-		glm::quat q(RotationKey.w, RotationKey.x, RotationKey.y, RotationKey.z);
-		glm::vec3 s = calcInterpolatedScaling(AnimationTime, pNodeAnim);
+	m_Skeleton.updateGlobalTransforms();
 
-		glm::mat4 S = glm::scale(glm::mat4(1), s);
-		glm::mat4 R = glm::mat4_cast(q);
-		glm::mat4 T = glm::translate(glm::mat4(1), t);
+	// Every consumer reads the model-space transforms computed above
+	for (unsigned int i = 0; i < m_NumBones; i++)
+		m_BonePalette[i] = m_Skeleton.getGlobalTransform(m_BoneInfo[i].Node) * m_BoneInfo[i].BoneOffset;
 
-		glm_to_ai(T * R * S, pNode->mTransformation);
-	}
-#endif
-
-	for (unsigned int i = 0; i < pNode->mNumChildren; i++)
+	for (unsigned int i = 0; i < m_MeshNodes.size(); i++)
 	{
-		readNodeHierarchy(AnimationTime, pNode->mChildren[i], worldTransform);
+		if (m_MeshNodes[i] >= 0 && !m_Entries[i].Skinned)
+			m_meshTransformMatrices[i] = m_Skeleton.getGlobalTransform(m_MeshNodes[i]);
 	}
 }
 
 bool Model::transformBones(float TimeInSeconds)
 {
+	if (m_LoadState == LoadState::Loading || m_Clips.empty())
+		return false;
 
-	aiMatrix4x4 Identity;
-	aiIdentityMatrix4(&Identity);
+	const AnimationClip &Clip = m_Clips[0];
+	const float TimeInTicks = TimeInSeconds * Clip.getTicksPerSecond();
+	const float AnimationTime = fmod(TimeInTicks, Clip.getDuration());
 
-	const float TicksPerSecond = (float)(m_pScene->mAnimations[0]->mTicksPerSecond != 0 ? m_pScene->mAnimations[0]->mTicksPerSecond : 25.0f);
-	const float TimeInTicks = TimeInSeconds * TicksPerSecond;
-	const float AnimationTime = fmod(TimeInTicks, (float)m_pScene->mAnimations[0]->mDuration);
+	// Sample all tracks of the clip in one sweep, the pose pass only reads the results
+	utils::Timer timer;
+	Clip.sample(AnimationTime, m_KeyCursors, m_Pose);
+	m_Stats.SampleMs = timer.elapsedMs();
 
-	transformAllMeshes();
+	timer.reset();
+	updatePose();
+	m_Stats.PoseMs = timer.elapsedMs();
 
-	readNodeHierarchy(AnimationTime, m_pScene->mRootNode, Identity);
+	// Either skin every vertex here or only upload the bone matrices for the vertex shader
+	timer.reset();
+	if (m_SkinningMode == SkinningMode::GPU)
+		uploadBonePalette();
+	else
+		transformAllMeshes();
+	m_Stats.SkinMs = timer.elapsedMs();
 
-	return TimeInTicks > static_cast<float>(m_pScene->mAnimations[0]->mDuration);
+	return TimeInTicks > Clip.getDuration();
 }
-
-const aiNodeAnim *Model::findNodeAnim(const aiAnimation *pAnimation, const std::string NodeName)
-{
-	for (unsigned int i = 0; i < pAnimation->mNumChannels; i++)
-	{
-		const aiNodeAnim *pNodeAnim = pAnimation->mChannels[i];
-
-		if (std::string(pNodeAnim->mNodeName.data) == NodeName)
-		{
-			return pNodeAnim;
-		}
-	}
-
-	return nullptr;
-}
\ No newline at end of file
@@ -1,9 +1,15 @@
 #pragma once
 #include <GL/glew.h>
 
+#include "AnimationClip.h"
 #include "Camera.h"
+#include "Skeleton.h"
+#include "Skinning.h"
+#include "StreamBuffer.h"
 #include <cassert>
+#include <future>
 #include <map>
+#include <memory>
 #include <vector>
 
 #include <glm/glm.hpp>
@@ -13,7 +19,9 @@
 #include <assimp/scene.h>
 
 #include "Shader.h"
+#include "ShaderVariants.h"
 #include "Texture.h"
+#include "utils/MappedFile.h"
 
 class Model
 {
@@ -27,10 +35,59 @@ class Model
 	 */
 	bool loadMesh(const std::string &Filename);
 
+	enum class LoadState
+	{
+		Idle,
+		Loading,
+		Ready,
+		Failed
+	};
+
+	/*
+	 * Starts loading mesh from given file on a worker thread, which imports it and decodes its
+	 * textures. updateLoading() needs to be called on the OpenGL thread to finish it. While
+	 * loading, the model renders nothing and must not be accessed otherwise.
+	 */
+	void loadMeshAsync(const std::string &Filename);
+
+	/*
+	 * Creates the buffers and textures once the worker is done, call once per frame on the OpenGL thread.
+	 */
+	LoadState updateLoading();
+	LoadState getLoadState() const { return m_LoadState; }
+
+	// Maximum number of bones when skinning on the GPU, needs to match mesh.vert
+	static constexpr unsigned int MAX_BONES = 256;
+	// Uniform buffer binding the bone palette is bound to
+	static constexpr GLuint BONE_PALETTE_BINDING = 0;
+
+	enum class SkinningMode
+	{
+		CPU, // vertices are skinned on the CPU and streamed every frame
+		GPU	 // only the bone palette is uploaded, the SKINNED mesh shader variant transforms the vertices
+	};
+
+	// Variant bits of the mesh shaders, bit i enables MESH_DEFINES[i]
+	static constexpr uint32_t MESH_SKINNED = 1 << 0;
+	static constexpr uint32_t MESH_TEXTURED = 1 << 1;
+	static const std::vector<std::string> MESH_DEFINES;
+
+	/*
+	 * Renders mesh with the camera and lights of the bound frame block (see FrameUniforms). Every
+	 * entry uses the mesh shader variant matching it, MESH_SKINNED is only set when skinning on the GPU.
+	 */
+	void render(ShaderVariants &meshShaders);
+
+	/*
+	 * Selects where vertices are skinned, returns false if the model has too many bones for the GPU.
+	 */
+	bool setSkinningMode(SkinningMode Mode);
+	SkinningMode getSkinningMode() const { return m_SkinningMode; }
+
 	/*
-	 * Renders mesh using given shader and camera.
+	 * Binds the BonePalette block of given skinning shader to BONE_PALETTE_BINDING.
 	 */
-	void render(Shader &shader, Camera &camera);
+	static void bindBonePalette(const Shader &shader);
 
 	unsigned int NumBones() const { return m_NumBones; }
 
@@ -40,40 +97,111 @@ class Model
 	bool transformBones(float TimeInSeconds);
 
 	/*
-	 * Retrieve skeleton.
+	 * Bone of the skeletal rig, running from the parent's position to the node's position.
+	 */
+	struct RigBone
+	{
+		unsigned int Node;
+		glm::vec3 Start;
+		glm::vec3 End;
+	};
+
+	/*
+	 * Returns index of the node with given name, or -1 if there is none.
+	 */
+	int findNode(const std::string &Name) const;
+
+	/*
+	 * Returns name of given node.
 	 */
-	std::vector<std::tuple<std::string, glm::vec3, glm::vec3>> getSkeletalRig(std::string rootNodeName);
+	const std::string &getNodeName(unsigned int Node) const { return m_Skeleton.getName(Node); }
+
+	/*
+	 * Retrieve skeleton below given node. Bones is cleared and refilled, so reusing the same
+	 * vector every frame does not allocate. Returns number of bones.
+	 */
+	unsigned int getSkeletalRig(int RootNode, std::vector<RigBone> &Bones) const;
+
+	/*
+	 * Timings of the last transformBones call, in milliseconds.
+	 */
+	struct FrameStats
+	{
+		float SampleMs = 0.0f;
+		float PoseMs = 0.0f;
+		float SkinMs = 0.0f;
+	};
+
+	const FrameStats &getFrameStats() const { return m_Stats; }
 
   private:
 	struct BoneInfo
 	{
 		BoneInfo() = default;
 		glm::mat4 BoneOffset;
-		glm::mat4 FinalTransformation;
+		int Node = -1; // index of the bone's node in the skeleton
 	};
 
-	/// Linearly interpolate from last animation position to current one, based on  keyframe time of animations
-	glm::vec3 calcInterpolatedPosition(float AnimationTime, const aiNodeAnim *pNodeAnim);
-
-	/// Spherically interpolates between quaternion rotations
-	void calcInterpolatedRotation(aiQuaternion &Out, float AnimationTime, const aiNodeAnim *pNodeAnim);
+	/*
+	 * Computes local and model-space transforms of all nodes from the sampled tracks.
+	 */
+	void updatePose();
 
-	/// Linearly interpolate from last animation scale to current one, based on  keyframe time of animations
-	glm::vec3 calcInterpolatedScaling(float AnimationTime, const aiNodeAnim *pNodeAnim);
+	/*
+	 * Vertex and index data uploaded to the GPU. Points either to the streams built from
+	 * the Assimp scene or into the mapped cooked cache.
+	 */
+	struct VertexData
+	{
+		const glm::vec3 *Positions = nullptr;
+		const glm::vec3 *Normals = nullptr;
+		const glm::vec2 *TexCoords = nullptr;
+		const glm::uvec4 *BoneIds = nullptr;
+		const glm::vec4 *BoneWeights = nullptr;
+		unsigned int NumVertices = 0;
+		const unsigned int *Indices = nullptr;
+		unsigned int NumIndices = 0;
+	};
 
-	/// Finds the last keyframe before AnimationTime
-	unsigned int findScaling(float AnimationTime, const aiNodeAnim *pNodeAnim);
-	unsigned int findRotation(float AnimationTime, const aiNodeAnim *pNodeAnim);
-	unsigned int findPosition(float AnimationTime, const aiNodeAnim *pNodeAnim);
+	/*
+	 * Vertex and index streams built from the Assimp scene.
+	 */
+	struct VertexStreams
+	{
+		std::vector<glm::vec3> Positions;
+		std::vector<glm::vec3> Normals;
+		std::vector<glm::vec2> TexCoords;
+		std::vector<glm::uvec4> BoneIds;
+		std::vector<glm::vec4> BoneWeights;
+		std::vector<unsigned int> Indices;
+	};
 
-	// Helper functions to read Assimp data.
-	const aiNodeAnim *findNodeAnim(const aiAnimation *pAnimation, const std::string NodeName);
-	void readNodeHierarchy(float AnimationTime, aiNode *pNode, aiMatrix4x4 ParentTransform);
+	/*
+	 * Loading runs in two stages: prepareMesh() does not touch OpenGL and may run on a worker,
+	 * finalizeMesh() uploads the prepared data on the OpenGL thread.
+	 */
+	bool prepareMesh(const std::string &Filename);
+	bool finalizeMesh();
 
 	// Model intialization functions.
-	bool initFromScene(const aiScene *pScene, const std::string &Filename);
+	bool initFromScene(const aiScene *pScene, const std::string &Filename, const std::string &CachePath, uint64_t SourceHash);
 	void initMesh(unsigned int MeshIndex, const aiMesh *paiMesh, std::vector<glm::vec3> &Positions, std::vector<glm::vec3> &Normals, std::vector<glm::vec2> &TexCoords, std::vector<unsigned int> &Indices);
 	bool initMaterials(const aiScene *pScene, const std::string &Filename);
+	void decodeTextures();
+	void initAnimation();
+	bool initBuffers(const VertexData &Data);
+	std::vector<unsigned int> loadBones(const aiMesh *paiMesh);
+	bool initSkinningBuffers(const glm::vec3 *Positions, const glm::vec3 *Normals);
+
+	/*
+	 * Cooked cache holding everything initFromScene produces, so warm starts skip Assimp.
+	 * The cache is keyed by hashSource(), a hash of the source file and the import settings.
+	 */
+	uint64_t hashSource(const std::string &Filename) const;
+	void saveCache(const std::string &CachePath, uint64_t SourceHash, const VertexData &Data) const;
+	bool loadCache(const std::string &CachePath, uint64_t SourceHash);
+	bool validateCache(const VertexData &Data) const;
+	void bindSkinStream();
 
 	void clear();
 	/*
@@ -81,6 +209,11 @@ class Model
 	 */
 	void transformAllMeshes();
 
+	/*
+	 * Uploads the bone palette of the current pose for skinning on the GPU.
+	 */
+	void uploadBonePalette();
+
 #define INVALID_MATERIAL 0xFFFFFFFF
 
 	enum VB_TYPES
@@ -89,6 +222,8 @@ class Model
 		POS_VB,
 		NORMAL_VB,
 		TEXCOORD_VB,
+		BONE_ID_VB,
+		BONE_WEIGHT_VB,
 		NUM_VBs
 	};
 
@@ -104,6 +239,7 @@ class Model
 			BaseVertex = 0;
 			BaseIndex = 0;
 			MaterialIndex = INVALID_MATERIAL;
+			Skinned = false;
 		}
 
 		//Number of indices in mesh
@@ -116,15 +252,59 @@ class Model
 		unsigned int BaseIndex;
 
 		unsigned int MaterialIndex;
+		//Whether vertices are transformed by bones every frame
+		bool Skinned;
+
+		// Bytes written by write(), five 32-bit fields and one byte
+		static constexpr size_t SERIALIZED_SIZE = 5 * sizeof(uint32_t) + 1;
+
+		void write(utils::BinaryWriter &Writer) const;
+		void read(utils::BinaryReader &Reader);
 	};
 
 	std::vector<MeshEntry> m_Entries;
 	std::vector<glm::mat4> m_meshTransformMatrices;
-	std::vector<Texture *> m_Textures;
+	std::vector<std::shared_ptr<Texture>> m_Textures; // shared with other models through the texture cache
+	std::vector<std::string> m_TexturePaths; // per material, empty if it has no diffuse texture
 	std::map<std::string, unsigned int> m_BoneMapping; // maps a bone name to its index
 	unsigned int m_NumBones;
 	std::vector<BoneInfo> m_BoneInfo;
+	std::vector<glm::mat4> m_BonePalette; // model-space bone matrices including their offsets, per frame
+	std::vector<SkinnedMesh> m_SkinnedMeshes;
+	// Skinned vertices of all meshes are streamed every frame, the VAO draws them from the current region
+	static constexpr unsigned int SKINNING_FRAMES_IN_FLIGHT = 3;
+	StreamBuffer m_SkinStream;
+	StreamBuffer m_PaletteStream;
+	// Draw blocks of all entries, written once per render and bound per draw
+	StreamBuffer m_DrawStream;
+	SkinningMode m_SkinningMode;
+	GLuint m_SkinnedVAO;
+	unsigned int m_NumSkinnedVertices;
+	// Where each skinned mesh starts in the mapped region, updated every frame
+	std::vector<glm::vec3 *> m_SkinnedPositionPtrs;
+	std::vector<glm::vec3 *> m_SkinnedNormalPtrs;
+
+	Skeleton m_Skeleton;
+	std::vector<int> m_MeshNodes; // maps a mesh to the node referencing it
+
+	// Animations compiled from the scene, the first one is played back
+	std::vector<AnimationClip> m_Clips;
+	std::vector<KeyframeCursor> m_KeyCursors; // one per track of the active clip
+	PoseStreams m_Pose;
+	std::vector<unsigned int> m_TrackNodes; // maps a track to the skeleton node it animates
+
+	FrameStats m_Stats;
 
 	const aiScene *m_pScene;
 	Assimp::Importer m_Importer;
+	bool m_Normalize;
+
+	// Data prepared by the loading stage, released once it is uploaded
+	VertexStreams m_PendingStreams;
+	utils::MappedFile m_PendingCache;
+	VertexData m_PendingData;
+	std::vector<std::shared_ptr<Texture>> m_PendingTextures;
+
+	LoadState m_LoadState;
+	std::future<bool> m_LoadTask;
 };
\ No newline at end of file
@@ -0,0 +1,92 @@
+#include "PixelConvert.h"
+
+#include "utils/CpuFeatures.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define PIXELS_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#define PIXELS_TARGET_AVX2
+#else
+#define PIXELS_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#else
+#define PIXELS_X86 0
+#endif
+
+namespace pixels
+{
+
+static inline unsigned int swapRedBlue(unsigned int Pixel)
+{
+	return (Pixel & 0xFF00FF00u) | ((Pixel >> 16) & 0xFFu) | ((Pixel & 0xFFu) << 16);
+}
+
+static void swizzleRowScalar(const unsigned int *Src, unsigned int *Dst, unsigned int Width)
+{
+	for (unsigned int x = 0; x < Width; x++)
+		Dst[x] = swapRedBlue(Src[x]);
+}
+
+#if PIXELS_X86
+
+static void swizzleRowSSE(const unsigned int *Src, unsigned int *Dst, unsigned int Width)
+{
+	// SSE2 has no byte shuffle, so the channels are moved with shifts and masks
+	const __m128i KeepGA = _mm_set1_epi32(static_cast<int>(0xFF00FF00u));
+	const __m128i LowByte = _mm_set1_epi32(0xFF);
+
+	unsigned int x = 0;
+	for (; x + 4 <= Width; x += 4)
+	{
+		const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i *>(Src + x));
+		const __m128i r = _mm_and_si128(_mm_srli_epi32(p, 16), LowByte);
+		const __m128i b = _mm_slli_epi32(_mm_and_si128(p, LowByte), 16);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(Dst + x), _mm_or_si128(_mm_and_si128(p, KeepGA), _mm_or_si128(r, b)));
+	}
+
+	swizzleRowScalar(Src + x, Dst + x, Width - x);
+}
+
+PIXELS_TARGET_AVX2 static void swizzleRowAVX2(const unsigned int *Src, unsigned int *Dst, unsigned int Width)
+{
+	const __m256i Shuffle = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+											 2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+	unsigned int x = 0;
+	for (; x + 8 <= Width; x += 8)
+	{
+		const __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(Src + x));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(Dst + x), _mm256_shuffle_epi8(p, Shuffle));
+	}
+
+	swizzleRowScalar(Src + x, Dst + x, Width - x);
+}
+
+#endif
+
+void bgraToRgba(const unsigned char *Src, size_t SrcPitch, unsigned int *Dst, unsigned int Width, unsigned int Height)
+{
+	void (*swizzleRow)(const unsigned int *, unsigned int *, unsigned int) = swizzleRowScalar;
+#if PIXELS_X86
+	// SSE2 is part of every x86-64 CPU, AVX2 is detected at runtime
+	swizzleRow = utils::cpu::hasAVX2() ? swizzleRowAVX2 : swizzleRowSSE;
+#endif
+
+	const int Rows = static_cast<int>(Height);
+#pragma omp parallel for schedule(static)
+	for (int y = 0; y < Rows; y++)
+		swizzleRow(reinterpret_cast<const unsigned int *>(Src + SrcPitch * y), Dst + static_cast<size_t>(Width) * y, Width);
+}
+
+void copyRows(const unsigned char *Src, size_t SrcPitch, unsigned int *Dst, unsigned int Width, unsigned int Height)
+{
+	const int Rows = static_cast<int>(Height);
+#pragma omp parallel for schedule(static)
+	for (int y = 0; y < Rows; y++)
+		std::memcpy(Dst + static_cast<size_t>(Width) * y, Src + SrcPitch * y, sizeof(unsigned int) * Width);
+}
+
+} // namespace pixels
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+
+namespace pixels
+{
+
+/*
+ * Converts 32-bit BGRA rows to RGBA by swapping the red and blue channel of every pixel.
+ * Rows are converted in parallel, with AVX2 where utils::cpu::hasAVX2() reports it and SSE2 otherwise.
+ * @param Src			First source row
+ * @param SrcPitch		Distance between source rows in bytes
+ * @param Dst			Output, Width * Height tightly packed pixels
+ * @param Width			Pixels per row
+ * @param Height		Number of rows
+ */
+void bgraToRgba(const unsigned char *Src, size_t SrcPitch, unsigned int *Dst, unsigned int Width, unsigned int Height);
+
+/*
+ * Copies 32-bit rows that already are in the right channel order into a tightly packed image.
+ */
+void copyRows(const unsigned char *Src, size_t SrcPitch, unsigned int *Dst, unsigned int Width, unsigned int Height);
+
+} // namespace pixels
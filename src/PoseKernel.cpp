@@ -0,0 +1,316 @@
+#include "PoseKernel.h"
+
+#include "utils/CpuFeatures.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define POSE_KERNEL_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#define POSE_TARGET_AVX2
+#else
+#define POSE_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+#else
+#define POSE_KERNEL_X86 0
+#endif
+
+void PoseStreams::resize(unsigned int Count)
+{
+	m_Count = Count;
+	const unsigned int Padded = (Count + pose::LaneWidth - 1) / pose::LaneWidth * pose::LaneWidth;
+
+	for (auto *Stream : {&Tx, &Ty, &Tz, &Qx, &Qy, &Qz})
+		Stream->assign(Padded, 0.0f);
+	for (auto *Stream : {&Qw, &Sx, &Sy, &Sz})
+		Stream->assign(Padded, 1.0f);
+}
+
+void PoseStreams::setTranslation(unsigned int i, const glm::vec3 &t)
+{
+	Tx[i] = t.x;
+	Ty[i] = t.y;
+	Tz[i] = t.z;
+}
+
+void PoseStreams::setRotation(unsigned int i, float x, float y, float z, float w)
+{
+	Qx[i] = x;
+	Qy[i] = y;
+	Qz[i] = z;
+	Qw[i] = w;
+}
+
+void PoseStreams::setScale(unsigned int i, const glm::vec3 &s)
+{
+	Sx[i] = s.x;
+	Sy[i] = s.y;
+	Sz[i] = s.z;
+}
+
+namespace pose
+{
+
+/// Same result as glm::translate(t) * glm::mat4_cast(q) * glm::scale(s), one lane at a time
+static void composeScalar(const PoseStreams &Pose, const unsigned int *Targets, glm::mat4 *Out)
+{
+	for (unsigned int i = 0; i < Pose.size(); i++)
+	{
+		const float x = Pose.Qx[i], y = Pose.Qy[i], z = Pose.Qz[i], w = Pose.Qw[i];
+		const float xx = x * x, yy = y * y, zz = z * z;
+		const float xy = x * y, xz = x * z, yz = y * z;
+		const float wx = w * x, wy = w * y, wz = w * z;
+
+		glm::mat4 &M = Out[Targets[i]];
+		M[0] = glm::vec4(1.0f - 2.0f * (yy + zz), 2.0f * (xy + wz), 2.0f * (xz - wy), 0.0f) * Pose.Sx[i];
+		M[1] = glm::vec4(2.0f * (xy - wz), 1.0f - 2.0f * (xx + zz), 2.0f * (yz + wx), 0.0f) * Pose.Sy[i];
+		M[2] = glm::vec4(2.0f * (xz + wy), 2.0f * (yz - wx), 1.0f - 2.0f * (xx + yy), 0.0f) * Pose.Sz[i];
+		M[3] = glm::vec4(Pose.Tx[i], Pose.Ty[i], Pose.Tz[i], 1.0f);
+	}
+}
+
+static void localToModelScalar(const int *Parents, const glm::mat4 *Local, glm::mat4 *Global, unsigned int Count)
+{
+	for (unsigned int i = 0; i < Count; i++)
+		Global[i] = Parents[i] < 0 ? Local[i] : Global[Parents[i]] * Local[i];
+}
+
+#if POSE_KERNEL_X86
+
+static void composeSSE(const PoseStreams &Pose, const unsigned int *Targets, glm::mat4 *Out)
+{
+	const __m128 One = _mm_set1_ps(1.0f);
+	const __m128 Two = _mm_set1_ps(2.0f);
+	const __m128 Zero = _mm_setzero_ps();
+
+	const unsigned int Count = Pose.size();
+	for (unsigned int i = 0; i < Count; i += 4)
+	{
+		const __m128 x = _mm_loadu_ps(&Pose.Qx[i]), y = _mm_loadu_ps(&Pose.Qy[i]);
+		const __m128 z = _mm_loadu_ps(&Pose.Qz[i]), w = _mm_loadu_ps(&Pose.Qw[i]);
+		const __m128 sx = _mm_loadu_ps(&Pose.Sx[i]), sy = _mm_loadu_ps(&Pose.Sy[i]), sz = _mm_loadu_ps(&Pose.Sz[i]);
+
+		const __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+		const __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+		const __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+		// Columns of T * R * S, one register per matrix element
+		__m128 c0x = _mm_mul_ps(_mm_sub_ps(One, _mm_mul_ps(Two, _mm_add_ps(yy, zz))), sx);
+		__m128 c0y = _mm_mul_ps(_mm_mul_ps(Two, _mm_add_ps(xy, wz)), sx);
+		__m128 c0z = _mm_mul_ps(_mm_mul_ps(Two, _mm_sub_ps(xz, wy)), sx);
+		__m128 c1x = _mm_mul_ps(_mm_mul_ps(Two, _mm_sub_ps(xy, wz)), sy);
+		__m128 c1y = _mm_mul_ps(_mm_sub_ps(One, _mm_mul_ps(Two, _mm_add_ps(xx, zz))), sy);
+		__m128 c1z = _mm_mul_ps(_mm_mul_ps(Two, _mm_add_ps(yz, wx)), sy);
+		__m128 c2x = _mm_mul_ps(_mm_mul_ps(Two, _mm_add_ps(xz, wy)), sz);
+		__m128 c2y = _mm_mul_ps(_mm_mul_ps(Two, _mm_sub_ps(yz, wx)), sz);
+		__m128 c2z = _mm_mul_ps(_mm_sub_ps(One, _mm_mul_ps(Two, _mm_add_ps(xx, yy))), sz);
+		__m128 c3x = _mm_loadu_ps(&Pose.Tx[i]), c3y = _mm_loadu_ps(&Pose.Ty[i]), c3z = _mm_loadu_ps(&Pose.Tz[i]);
+		__m128 c0w = Zero, c1w = Zero, c2w = Zero, c3w = One;
+
+		// Transpose lanes back into one column per register
+		_MM_TRANSPOSE4_PS(c0x, c0y, c0z, c0w);
+		_MM_TRANSPOSE4_PS(c1x, c1y, c1z, c1w);
+		_MM_TRANSPOSE4_PS(c2x, c2y, c2z, c2w);
+		_MM_TRANSPOSE4_PS(c3x, c3y, c3z, c3w);
+
+		const __m128 Columns[4][4] = {{c0x, c1x, c2x, c3x}, {c0y, c1y, c2y, c3y}, {c0z, c1z, c2z, c3z}, {c0w, c1w, c2w, c3w}};
+		const unsigned int Lanes = Count - i < 4 ? Count - i : 4;
+		for (unsigned int Lane = 0; Lane < Lanes; Lane++)
+		{
+			float *M = &Out[Targets[i + Lane]][0][0];
+			_mm_storeu_ps(M + 0, Columns[Lane][0]);
+			_mm_storeu_ps(M + 4, Columns[Lane][1]);
+			_mm_storeu_ps(M + 8, Columns[Lane][2]);
+			_mm_storeu_ps(M + 12, Columns[Lane][3]);
+		}
+	}
+}
+
+static void localToModelSSE(const int *Parents, const glm::mat4 *Local, glm::mat4 *Global, unsigned int Count)
+{
+	for (unsigned int i = 0; i < Count; i++)
+	{
+		if (Parents[i] < 0)
+		{
+			Global[i] = Local[i];
+			continue;
+		}
+
+		const float *P = &Global[Parents[i]][0][0];
+		const float *L = &Local[i][0][0];
+		float *G = &Global[i][0][0];
+
+		const __m128 p0 = _mm_loadu_ps(P + 0), p1 = _mm_loadu_ps(P + 4);
+		const __m128 p2 = _mm_loadu_ps(P + 8), p3 = _mm_loadu_ps(P + 12);
+
+		// Every column of the result is the parent matrix times a column of the local matrix
+		for (int c = 0; c < 4; c++)
+		{
+			const __m128 l = _mm_loadu_ps(L + c * 4);
+			__m128 r = _mm_mul_ps(p0, _mm_shuffle_ps(l, l, _MM_SHUFFLE(0, 0, 0, 0)));
+			r = _mm_add_ps(r, _mm_mul_ps(p1, _mm_shuffle_ps(l, l, _MM_SHUFFLE(1, 1, 1, 1))));
+			r = _mm_add_ps(r, _mm_mul_ps(p2, _mm_shuffle_ps(l, l, _MM_SHUFFLE(2, 2, 2, 2))));
+			r = _mm_add_ps(r, _mm_mul_ps(p3, _mm_shuffle_ps(l, l, _MM_SHUFFLE(3, 3, 3, 3))));
+			_mm_storeu_ps(G + c * 4, r);
+		}
+	}
+}
+
+POSE_TARGET_AVX2 static void composeAVX2(const PoseStreams &Pose, const unsigned int *Targets, glm::mat4 *Out)
+{
+	const __m256 One = _mm256_set1_ps(1.0f);
+	const __m256 Two = _mm256_set1_ps(2.0f);
+	const __m256 Zero = _mm256_setzero_ps();
+
+	const unsigned int Count = Pose.size();
+	for (unsigned int i = 0; i < Count; i += 8)
+	{
+		const __m256 x = _mm256_loadu_ps(&Pose.Qx[i]), y = _mm256_loadu_ps(&Pose.Qy[i]);
+		const __m256 z = _mm256_loadu_ps(&Pose.Qz[i]), w = _mm256_loadu_ps(&Pose.Qw[i]);
+		const __m256 sx = _mm256_loadu_ps(&Pose.Sx[i]), sy = _mm256_loadu_ps(&Pose.Sy[i]), sz = _mm256_loadu_ps(&Pose.Sz[i]);
+
+		const __m256 xx = _mm256_mul_ps(x, x), yy = _mm256_mul_ps(y, y), zz = _mm256_mul_ps(z, z);
+		const __m256 xy = _mm256_mul_ps(x, y), xz = _mm256_mul_ps(x, z), yz = _mm256_mul_ps(y, z);
+		const __m256 wx = _mm256_mul_ps(w, x), wy = _mm256_mul_ps(w, y), wz = _mm256_mul_ps(w, z);
+
+		// Columns of T * R * S, one register per matrix element
+		const __m256 Elements[4][4] = {
+			{_mm256_mul_ps(_mm256_fnmadd_ps(Two, _mm256_add_ps(yy, zz), One), sx),
+			 _mm256_mul_ps(_mm256_mul_ps(Two, _mm256_add_ps(xy, wz)), sx),
+			 _mm256_mul_ps(_mm256_mul_ps(Two, _mm256_sub_ps(xz, wy)), sx),
+			 Zero},
+			{_mm256_mul_ps(_mm256_mul_ps(Two, _mm256_sub_ps(xy, wz)), sy),
+			 _mm256_mul_ps(_mm256_fnmadd_ps(Two, _mm256_add_ps(xx, zz), One), sy),
+			 _mm256_mul_ps(_mm256_mul_ps(Two, _mm256_add_ps(yz, wx)), sy),
+			 Zero},
+			{_mm256_mul_ps(_mm256_mul_ps(Two, _mm256_add_ps(xz, wy)), sz),
+			 _mm256_mul_ps(_mm256_mul_ps(Two, _mm256_sub_ps(yz, wx)), sz),
+			 _mm256_mul_ps(_mm256_fnmadd_ps(Two, _mm256_add_ps(xx, yy), One), sz),
+			 Zero},
+			{_mm256_loadu_ps(&Pose.Tx[i]), _mm256_loadu_ps(&Pose.Ty[i]), _mm256_loadu_ps(&Pose.Tz[i]), One}};
+
+		const unsigned int Lanes = Count - i < 8 ? Count - i : 8;
+		for (int c = 0; c < 4; c++)
+		{
+			// Transpose within both 128-bit halves, giving column c of lanes (0, 4), (1, 5), (2, 6) and (3, 7)
+			const __m256 t0 = _mm256_unpacklo_ps(Elements[c][0], Elements[c][1]);
+			const __m256 t1 = _mm256_unpackhi_ps(Elements[c][0], Elements[c][1]);
+			const __m256 t2 = _mm256_unpacklo_ps(Elements[c][2], Elements[c][3]);
+			const __m256 t3 = _mm256_unpackhi_ps(Elements[c][2], Elements[c][3]);
+			const __m256 Column[4] = {_mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0)), _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2)),
+									  _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0)), _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2))};
+
+			for (unsigned int Lane = 0; Lane < Lanes; Lane++)
+			{
+				const __m128 v = Lane < 4 ? _mm256_castps256_ps128(Column[Lane]) : _mm256_extractf128_ps(Column[Lane - 4], 1);
+				_mm_storeu_ps(&Out[Targets[i + Lane]][c][0], v);
+			}
+		}
+	}
+}
+
+POSE_TARGET_AVX2 static void localToModelAVX2(const int *Parents, const glm::mat4 *Local, glm::mat4 *Global, unsigned int Count)
+{
+	for (unsigned int i = 0; i < Count; i++)
+	{
+		if (Parents[i] < 0)
+		{
+			Global[i] = Local[i];
+			continue;
+		}
+
+		const float *P = &Global[Parents[i]][0][0];
+		const float *L = &Local[i][0][0];
+		float *G = &Global[i][0][0];
+
+		// Parent columns duplicated into both halves, so two result columns are computed at once
+		const __m256 p0 = _mm256_broadcast_ps((const __m128 *)(P + 0));
+		const __m256 p1 = _mm256_broadcast_ps((const __m128 *)(P + 4));
+		const __m256 p2 = _mm256_broadcast_ps((const __m128 *)(P + 8));
+		const __m256 p3 = _mm256_broadcast_ps((const __m128 *)(P + 12));
+
+		for (int c = 0; c < 4; c += 2)
+		{
+			const __m256 l = _mm256_loadu_ps(L + c * 4);
+			__m256 r = _mm256_mul_ps(p0, _mm256_shuffle_ps(l, l, _MM_SHUFFLE(0, 0, 0, 0)));
+			r = _mm256_fmadd_ps(p1, _mm256_shuffle_ps(l, l, _MM_SHUFFLE(1, 1, 1, 1)), r);
+			r = _mm256_fmadd_ps(p2, _mm256_shuffle_ps(l, l, _MM_SHUFFLE(2, 2, 2, 2)), r);
+			r = _mm256_fmadd_ps(p3, _mm256_shuffle_ps(l, l, _MM_SHUFFLE(3, 3, 3, 3)), r);
+			_mm256_storeu_ps(G + c * 4, r);
+		}
+	}
+}
+
+#endif
+
+Kernel detectKernel()
+{
+#if POSE_KERNEL_X86
+	return utils::cpu::hasAVX2() && utils::cpu::hasFMA() ? Kernel::AVX2 : Kernel::SSE;
+#else
+	return Kernel::Scalar;
+#endif
+}
+
+static Kernel ActiveKernel = detectKernel();
+
+void setKernel(Kernel kernel)
+{
+	const Kernel Best = detectKernel();
+	ActiveKernel = static_cast<int>(kernel) > static_cast<int>(Best) ? Best : kernel;
+}
+
+Kernel getKernel()
+{
+	return ActiveKernel;
+}
+
+const char *getKernelName(Kernel kernel)
+{
+	switch (kernel)
+	{
+	case Kernel::AVX2:
+		return "AVX2";
+	case Kernel::SSE:
+		return "SSE";
+	default:
+		return "Scalar";
+	}
+}
+
+void composeMatrices(const PoseStreams &Pose, const unsigned int *Targets, glm::mat4 *Out)
+{
+	switch (ActiveKernel)
+	{
+#if POSE_KERNEL_X86
+	case Kernel::AVX2:
+		composeAVX2(Pose, Targets, Out);
+		break;
+	case Kernel::SSE:
+		composeSSE(Pose, Targets, Out);
+		break;
+#endif
+	default:
+		composeScalar(Pose, Targets, Out);
+		break;
+	}
+}
+
+void localToModel(const int *Parents, const glm::mat4 *Local, glm::mat4 *Global, unsigned int Count)
+{
+	switch (ActiveKernel)
+	{
+#if POSE_KERNEL_X86
+	case Kernel::AVX2:
+		localToModelAVX2(Parents, Local, Global, Count);
+		break;
+	case Kernel::SSE:
+		localToModelSSE(Parents, Local, Global, Count);
+		break;
+#endif
+	default:
+		localToModelScalar(Parents, Local, Global, Count);
+		break;
+	}
+}
+
+} // namespace pose
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/*
+ * Structure-of-arrays pose, one lane per animation track. Every stream is padded
+ * to a multiple of pose::LaneWidth lanes holding the identity transform, so vector
+ * kernels never need a scalar tail.
+ */
+struct PoseStreams
+{
+	std::vector<float> Tx, Ty, Tz;
+	std::vector<float> Qx, Qy, Qz, Qw;
+	std::vector<float> Sx, Sy, Sz;
+
+	/*
+	 * Resizes all streams to hold Count lanes (plus padding), resetting them to identity.
+	 */
+	void resize(unsigned int Count);
+
+	unsigned int size() const { return m_Count; }
+
+	void setTranslation(unsigned int i, const glm::vec3 &t);
+	void setRotation(unsigned int i, float x, float y, float z, float w);
+	void setScale(unsigned int i, const glm::vec3 &s);
+
+  private:
+	unsigned int m_Count = 0;
+};
+
+namespace pose
+{
+
+// Widest supported vector width, streams are padded to a multiple of this
+constexpr unsigned int LaneWidth = 8;
+
+enum class Kernel
+{
+	Scalar,
+	SSE,
+	AVX2
+};
+
+/*
+ * Returns best kernel supported by the running CPU.
+ */
+Kernel detectKernel();
+
+/*
+ * Selects kernel used by composeMatrices and localToModel, defaults to detectKernel().
+ * Kernels not supported by the CPU fall back to the best supported one.
+ */
+void setKernel(Kernel kernel);
+Kernel getKernel();
+const char *getKernelName(Kernel kernel);
+
+/*
+ * Builds T * R * S matrices for every lane of Pose and stores lane i at Out[Targets[i]].
+ */
+void composeMatrices(const PoseStreams &Pose, const unsigned int *Targets, glm::mat4 *Out);
+
+/*
+ * Computes Global[i] = Global[Parents[i]] * Local[i] for Count nodes in depth-first order,
+ * nodes with a negative parent index copy their local transform.
+ */
+void localToModel(const int *Parents, const glm::mat4 *Local, glm::mat4 *Global, unsigned int Count);
+
+} // namespace pose
@@ -2,29 +2,85 @@
 
 #include "Shader.h"
 
+#include <algorithm>
+#include <cstdio>
 #include <string>
 #include <vector>
 
+#include "utils/BinaryStream.h"
 #include "utils/File.h"
 #include "utils/Logger.h"
+#include "utils/MappedFile.h"
 
-Shader::Shader(const char *vertexPath, const char *fragmentPath)
+// Linked programs are cached here, one file per program keyed by hashProgram
+constexpr const char *SHADER_CACHE_DIRECTORY = "ShaderCache";
+constexpr uint32_t BINARY_MAGIC = 0x47525053; // "SPRG"
+constexpr uint32_t BINARY_VERSION = 1;
+
+Shader::Shader(const char *vertexPath, const char *fragmentPath, const std::vector<std::string> &defines)
+	: m_VertPath(vertexPath), m_FragPath(fragmentPath)
+{
+	m_ShaderId = load(addDefines(utils::file::read(m_VertPath), defines), addDefines(utils::file::read(m_FragPath), defines));
+	reflectUniforms();
+}
+
+Shader::Shader(const char *vertexPath, const char *fragmentPath, const std::string &vertSource, const std::string &fragSource)
 	: m_VertPath(vertexPath), m_FragPath(fragmentPath)
 {
-	m_ShaderId = load();
+	m_ShaderId = load(vertSource, fragSource);
+	reflectUniforms();
 }
 
-GLuint Shader::load()
+std::string Shader::addDefines(const std::string &source, const std::vector<std::string> &defines)
+{
+	if (defines.empty())
+		return source;
+
+	// #version has to stay the first statement, defines go right after it
+	size_t insert = 0;
+	const size_t version = source.find("#version");
+	if (version != std::string::npos)
+	{
+		const size_t end = source.find('\n', version);
+		insert = end != std::string::npos ? end + 1 : source.size();
+	}
+
+	std::string lines = insert > 0 && source[insert - 1] != '\n' ? "\n" : "";
+	for (const auto &define : defines)
+		lines += "#define " + define + "\n";
+
+	const size_t nextLine = std::count(source.begin(), source.begin() + insert, '\n') + 1;
+	lines += "#line " + std::to_string(nextLine) + "\n";
+
+	std::string result = source;
+	result.insert(insert, lines);
+	return result;
+}
+
+GLuint Shader::load(const std::string &vertSource, const std::string &fragSource)
+{
+	// Drivers without binary formats cannot load what they returned, so always compile there
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	const uint64_t key = formats > 0 ? hashProgram(vertSource, fragSource) : 0;
+
+	if (key != 0)
+	{
+		if (const GLuint program = loadBinary(key))
+			return program;
+	}
+
+	return compile(vertSource, fragSource, key);
+}
+
+GLuint Shader::compile(const std::string &vertSource, const std::string &fragSource, uint64_t binaryKey)
 {
 	const GLuint program = glCreateProgram();
 	const GLuint vert_shader = glCreateShader(GL_VERTEX_SHADER);
 	const GLuint frag_shader = glCreateShader(GL_FRAGMENT_SHADER);
 
-	std::string vert_string = utils::file::read(m_VertPath);
-	std::string frag_string = utils::file::read(m_FragPath);
-
-	const char *vert_source = vert_string.c_str();
-	const char *frag_source = frag_string.c_str();
+	const char *vert_source = vertSource.c_str();
+	const char *frag_source = fragSource.c_str();
 
 	glShaderSource(vert_shader, 1, &vert_source, nullptr);
 	glCompileShader(vert_shader);
@@ -37,15 +93,176 @@ GLuint Shader::load()
 	glAttachShader(program, vert_shader);
 	glAttachShader(program, frag_shader);
 
+	if (binaryKey != 0)
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
 	glLinkProgram(program);
+	checkCompileErrors(program, "PROGRAM");
 	glValidateProgram(program);
 
+	glDetachShader(program, vert_shader);
+	glDetachShader(program, frag_shader);
 	glDeleteShader(vert_shader);
 	glDeleteShader(frag_shader);
 
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (linked && binaryKey != 0)
+		saveBinary(program, binaryKey);
+
+	return program;
+}
+
+uint64_t Shader::hashProgram(const std::string &vertSource, const std::string &fragSource)
+{
+	// A driver update may change the binary format without changing its enum, so it is part of the key
+	uint64_t hash = utils::hash::FNV_OFFSET_BASIS;
+	for (const GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION})
+	{
+		const char *value = reinterpret_cast<const char *>(glGetString(name));
+		hash = utils::hash::fnv1aString(value ? value : "", hash);
+		hash = utils::hash::fnv1a("\n", 1, hash);
+	}
+
+	const uint64_t vertSize = vertSource.size();
+	hash = utils::hash::fnv1a(&vertSize, sizeof(vertSize), hash);
+	hash = utils::hash::fnv1a(vertSource.data(), vertSource.size(), hash);
+	hash = utils::hash::fnv1a(fragSource.data(), fragSource.size(), hash);
+
+	// 0 means no cache
+	return hash != 0 ? hash : 1;
+}
+
+static std::string binaryPath(uint64_t key)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+	return std::string(SHADER_CACHE_DIRECTORY) + "/" + name;
+}
+
+GLuint Shader::loadBinary(uint64_t key)
+{
+	utils::MappedFile cache;
+	if (!cache.open(binaryPath(key)))
+		return 0;
+
+	utils::BinaryReader reader(cache.data(), cache.size());
+	if (reader.read<uint32_t>() != BINARY_MAGIC || reader.read<uint32_t>() != BINARY_VERSION || reader.read<uint64_t>() != key)
+		return 0;
+
+	const GLenum format = reader.read<GLenum>();
+	size_t size = 0;
+	const char *binary = reader.viewArray<char>(size);
+	if (!reader.ok() || size == 0)
+		return 0;
+
+	// The driver rejects binaries it cannot use, the caller then compiles from source
+	const GLuint program = glCreateProgram();
+	glProgramBinary(program, format, binary, static_cast<GLsizei>(size));
+
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (!linked)
+	{
+		DEBUG("Program binary %s was rejected by the driver", binaryPath(key).c_str());
+		glDeleteProgram(program);
+		return 0;
+	}
+
 	return program;
 }
 
+void Shader::saveBinary(GLuint program, uint64_t key)
+{
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	std::vector<char> binary(static_cast<size_t>(length));
+	GLenum format = 0;
+	glGetProgramBinary(program, length, &length, &format, binary.data());
+	binary.resize(static_cast<size_t>(length));
+
+	utils::BinaryWriter writer;
+	writer.write(BINARY_MAGIC);
+	writer.write(BINARY_VERSION);
+	writer.write(key);
+	writer.write(format);
+	writer.writeArray(binary);
+
+	const std::string path = binaryPath(key);
+	if (!utils::file::createDirectory(SHADER_CACHE_DIRECTORY) || !writer.save(path))
+		WARNING("Could not write program binary '%s'", path.c_str());
+}
+
+void Shader::reflectUniforms()
+{
+	m_Uniforms.clear();
+
+	GLint count = 0, maxLength = 0;
+	glGetProgramiv(m_ShaderId, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(m_ShaderId, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+	std::vector<GLchar> name(std::max(maxLength, 1));
+
+	for (GLint i = 0; i < count; i++)
+	{
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(m_ShaderId, static_cast<GLuint>(i), static_cast<GLsizei>(name.size()), nullptr, &size, &type, name.data());
+
+		// Members of uniform blocks have no location
+		const GLint location = glGetUniformLocation(m_ShaderId, name.data());
+		if (location < 0)
+			continue;
+
+		// Arrays of basic types are reported as "name[0]", they can be set by their plain name or per element.
+		// Members of struct arrays ("lights[1].color") are reported one by one and keep their full name.
+		std::string baseName = name.data();
+		const bool isArray = baseName.size() >= 3 && baseName.compare(baseName.size() - 3, 3, "[0]") == 0;
+		if (isArray)
+			baseName.resize(baseName.size() - 3);
+
+		const uint64_t hash = utils::hash::fnv1aString(baseName.c_str());
+		m_Uniforms.push_back({hash, location});
+		if (!isArray)
+			continue;
+
+		for (GLint element = 0; element < size; element++)
+		{
+			const std::string elementName = baseName + "[" + std::to_string(element) + "]";
+			const GLint elementLocation = glGetUniformLocation(m_ShaderId, elementName.c_str());
+			if (elementLocation >= 0)
+				m_Uniforms.push_back({hashArrayElement(hash, element), elementLocation});
+		}
+	}
+
+	std::sort(m_Uniforms.begin(), m_Uniforms.end(), [](const UniformInfo &a, const UniformInfo &b) { return a.Hash < b.Hash; });
+	for (size_t i = 1; i < m_Uniforms.size(); i++)
+	{
+		if (m_Uniforms[i].Hash == m_Uniforms[i - 1].Hash && m_Uniforms[i].Location != m_Uniforms[i - 1].Location)
+			WARNING("Uniform name hash collision in shader %s / %s", m_VertPath, m_FragPath);
+	}
+}
+
+uint64_t Shader::hashArrayElement(uint64_t nameHash, int index)
+{
+	// Same as hashing the whole "name[index]" string, without formatting it
+	char digits[12];
+	int length = 0;
+	unsigned int value = static_cast<unsigned int>(index);
+	do
+	{
+		digits[length++] = static_cast<char>('0' + value % 10);
+		value /= 10;
+	} while (value > 0);
+
+	uint64_t hash = utils::hash::fnv1a("[", 1, nameHash);
+	while (length > 0)
+		hash = utils::hash::fnv1a(&digits[--length], 1, hash);
+	return utils::hash::fnv1a("]", 1, hash);
+}
+
 void Shader::checkCompileErrors(GLuint shader, std::string type)
 {
 	GLint success;
@@ -68,7 +285,7 @@ void Shader::checkCompileErrors(GLuint shader, std::string type)
 		if (!success)
 		{
 			GLint maxLength = 0;
-			glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &maxLength);
+			glGetProgramiv(shader, GL_INFO_LOG_LENGTH, &maxLength);
 			infoLog.resize(maxLength);
 			glGetProgramInfoLog(shader, infoLog.size(), nullptr, infoLog.data());
 			WARNING("Shader compilation error of type: %s\n%s", type.c_str(), infoLog.data());
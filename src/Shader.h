@@ -4,6 +4,10 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "utils/Hash.h"
+
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -11,14 +15,43 @@
 class Shader
 {
   public:
+	/**
+	 * Uniform name identified by its hash. Constants of this type are hashed at compile time,
+	 * so setting a uniform through them involves no string handling. The constructor is explicit,
+	 * so a string literal cannot silently be hashed at runtime on every call.
+	 */
+	struct UniformName
+	{
+		uint64_t Hash;
+
+		constexpr explicit UniformName(const char *Name) : Hash(utils::hash::fnv1aString(Name)) {}
+	};
+
 	/**
    	 * Initializes a shader program
    	 * @param vertexPath
    	 * @param fragmentPath
+   	 * @param defines		Names defined in both stages, see addDefines
    	 */
-	explicit Shader(const char *vertexPath, const char *fragmentPath);
+	explicit Shader(const char *vertexPath, const char *fragmentPath, const std::vector<std::string> &defines = {});
+
+	/**
+	 * Initializes a shader program from sources that were already read
+	 * @param vertexPath	Only used in messages
+	 * @param fragmentPath	Only used in messages
+	 */
+	Shader(const char *vertexPath, const char *fragmentPath, const std::string &vertSource, const std::string &fragSource);
 	~Shader();
 
+	Shader(const Shader &) = delete;
+	Shader &operator=(const Shader &) = delete;
+
+	/**
+	 * Inserts a "#define name" line for every name after the #version line of source.
+	 * A #line directive keeps compiler messages pointing at the lines of the original file.
+	 */
+	static std::string addDefines(const std::string &source, const std::vector<std::string> &defines);
+
 	/**
 	 * Returns shader program ID
 	 * @return
@@ -54,7 +87,7 @@ class Shader
 	 * @param count			Number of elements (automatically retrieved from data if count = 0)
 	 */
 	template <typename T>
-	void setUniformFloatArray(const char *name, std::vector<T> data, GLboolean transpose = false, unsigned int offset = 0, unsigned int count = 0)
+	void setUniformFloatArray(UniformName name, std::vector<T> data, GLboolean transpose = false, unsigned int offset = 0, unsigned int count = 0)
 	{
 		const auto d = (GLfloat *)data.data();
 		const auto componentCount = sizeof(T) / 4;
@@ -98,7 +131,7 @@ class Shader
 	 * @param count			Number of elements (automatically retrieved from data if count = 0)
 	 */
 	template <typename T>
-	void setUniformIntArray(const char *name, std::vector<T> data, GLboolean transpose = false, unsigned int offset = 0, unsigned int count = 0)
+	void setUniformIntArray(UniformName name, std::vector<T> data, GLboolean transpose = false, unsigned int offset = 0, unsigned int count = 0)
 	{
 		const auto d = (GLint *)data.data();
 		const auto componentCount = sizeof(T) / 4;
@@ -134,7 +167,7 @@ class Shader
   	 * @param count			Number of elements (automatically retrieved from data if count = 0)
   	 */
 	template <typename T>
-	void setUniformUnsignedIntArray(const char *name, std::vector<T> data, GLboolean transpose = false, unsigned int offset = 0, unsigned int count = 0)
+	void setUniformUnsignedIntArray(UniformName name, std::vector<T> data, GLboolean transpose = false, unsigned int offset = 0, unsigned int count = 0)
 	{
 		const auto d = (GLuint *)data.data();
 		const auto componentCount = sizeof(T) / 4;
@@ -169,7 +202,7 @@ class Shader
 	 * @param transpose		Transpose value (only valid in case of matrix)
 	 */
 	template <typename T>
-	void setUniformFloat(const char *name, const T &value, GLboolean transpose = false)
+	void setUniformFloat(UniformName name, const T &value, GLboolean transpose = false)
 	{
 		const GLfloat *data = (GLfloat *)&value;
 		const auto componentCount = sizeof(T) / 4;
@@ -210,7 +243,7 @@ class Shader
    	 * @param transpose		Transpose value (only valid in case of matrix)
    	 */
 	template <typename T>
-	void setUniformInt(const char *name, const T &value, GLboolean transpose = false)
+	void setUniformInt(UniformName name, const T &value, GLboolean transpose = false)
 	{
 		const GLint *data = (GLint *)&value;
 		const auto componentCount = sizeof(T) / 4;
@@ -244,7 +277,7 @@ class Shader
   	 * @param transpose		Transpose value (only valid in case of matrix)
   	 */
 	template <typename T>
-	void setUniformUnsignedInt(const char *name, const T &value, GLboolean transpose = false)
+	void setUniformUnsignedInt(UniformName name, const T &value, GLboolean transpose = false)
 	{
 		const GLuint *data = (GLuint *)&value;
 		const auto componentCount = sizeof(T) / 4;
@@ -271,23 +304,17 @@ class Shader
 	}
 
 	/**
-	 * Return uniform location at 'name'
+	 * Return uniform location at 'name', looked up in the uniforms reflected after linking
 	 * @param name		Uniform name
 	 * @param index		Index of uniform array, -1 if uniform is not an array
-	 * @return			Uniform location
+	 * @return			Uniform location, -1 if the program has no such active uniform
 	 */
-	inline GLint getUniformLocation(const char *name, int index = -1)
+	inline GLint getUniformLocation(UniformName name, int index = -1) const
 	{
-		if (index >= 0)
-		{
-			char n[64]{};
-			std::sprintf(n, "%s[%i]", name, index);
-			return glGetUniformLocation(m_ShaderId, n);
-		}
-		else
-		{
-			return glGetUniformLocation(m_ShaderId, name);
-		}
+		const uint64_t hash = index >= 0 ? hashArrayElement(name.Hash, index) : name.Hash;
+		const auto it = std::lower_bound(m_Uniforms.begin(), m_Uniforms.end(), hash,
+										 [](const UniformInfo &uniform, uint64_t value) { return uniform.Hash < value; });
+		return it != m_Uniforms.end() && it->Hash == hash ? it->Location : -1;
 	}
 
 	/**
@@ -301,10 +328,46 @@ class Shader
 	}
 
   private:
+	struct UniformInfo
+	{
+		uint64_t Hash;
+		GLint Location;
+	};
+
 	GLuint m_ShaderId;
+	// Active uniforms sorted by name hash, array elements are stored individually
+	std::vector<UniformInfo> m_Uniforms;
 	const char *m_VertPath;
 	const char *m_FragPath;
 
-	GLuint load();
+	GLuint load(const std::string &vertSource, const std::string &fragSource);
 	void checkCompileErrors(GLuint shader, std::string type);
+
+	/**
+	 * Compiles and links the program from source
+	 * @param binaryKey		Key to store the linked binary under, 0 to skip the cache
+	 */
+	GLuint compile(const std::string &vertSource, const std::string &fragSource, uint64_t binaryKey);
+
+	/**
+	 * Hash identifying a program binary, covers the sources and the driver that produced it
+	 */
+	static uint64_t hashProgram(const std::string &vertSource, const std::string &fragSource);
+
+	/**
+	 * Creates the program from the binary cache
+	 * @return 	Program ID, 0 if there is no usable binary for key
+	 */
+	static GLuint loadBinary(uint64_t key);
+	static void saveBinary(GLuint program, uint64_t key);
+
+	/**
+	 * Queries all active uniforms of the linked program once
+	 */
+	void reflectUniforms();
+
+	/**
+	 * Hash of "name[index]" from the hash of "name"
+	 */
+	static uint64_t hashArrayElement(uint64_t nameHash, int index);
 };
\ No newline at end of file
@@ -0,0 +1,64 @@
+#include "ShaderVariants.h"
+
+#include "utils/File.h"
+#include "utils/Logger.h"
+#include "utils/Timer.h"
+
+#include <algorithm>
+#include <cassert>
+
+ShaderVariants::ShaderVariants(const std::string &VertexPath, const std::string &FragmentPath, std::vector<std::string> Defines)
+	: m_VertexPath(VertexPath), m_FragmentPath(FragmentPath), m_Defines(std::move(Defines))
+{
+	if (m_Defines.size() > MAX_DEFINES)
+	{
+		WARNING("Shader variants of %s support %zu defines, ignoring the other %zu", m_VertexPath.c_str(), MAX_DEFINES, m_Defines.size() - MAX_DEFINES);
+		m_Defines.resize(MAX_DEFINES);
+	}
+
+	m_Variants.resize(size_t(1) << m_Defines.size());
+
+	// Reading the files does not need the GL context, so it overlaps with the rest of startup
+	m_PendingSources = std::async(std::launch::async, [VertexPath, FragmentPath]() {
+		return Sources{utils::file::read(VertexPath), utils::file::read(FragmentPath)};
+	});
+}
+
+const ShaderVariants::Sources &ShaderVariants::getSources()
+{
+	if (m_PendingSources.valid())
+		m_Sources = m_PendingSources.get();
+
+	return m_Sources;
+}
+
+Shader &ShaderVariants::get(uint32_t Mask)
+{
+	assert(Mask < m_Variants.size());
+	Mask &= static_cast<uint32_t>(m_Variants.size() - 1);
+
+	std::unique_ptr<Shader> &Variant = m_Variants[Mask];
+	if (Variant)
+		return *Variant;
+
+	std::vector<std::string> Enabled;
+	for (size_t i = 0; i < m_Defines.size(); i++)
+	{
+		if (Mask & (1u << i))
+			Enabled.push_back(m_Defines[i]);
+	}
+
+	utils::Timer Timer;
+	const Sources &Source = getSources();
+	Variant.reset(new Shader(m_VertexPath.c_str(), m_FragmentPath.c_str(), Shader::addDefines(Source.Vertex, Enabled), Shader::addDefines(Source.Fragment, Enabled)));
+	if (m_Setup)
+		m_Setup(*Variant, Mask);
+
+	DEBUG("Created variant %u of %s / %s in %.2f ms", Mask, m_VertexPath.c_str(), m_FragmentPath.c_str(), Timer.elapsedMs());
+	return *Variant;
+}
+
+size_t ShaderVariants::getCompiledCount() const
+{
+	return std::count_if(m_Variants.begin(), m_Variants.end(), [](const std::unique_ptr<Shader> &Variant) { return Variant != nullptr; });
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Shader.h"
+
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+ * Permutations of one vertex/fragment source pair. Every variant is selected by a mask, bit i
+ * adds "#define Defines[i]" to both stages. The sources are read on a background thread when
+ * the set is created, a variant is compiled the first time it is requested and kept afterwards.
+ */
+class ShaderVariants
+{
+  public:
+	// Variants are stored per mask, so the number of defines is limited
+	static constexpr size_t MAX_DEFINES = 8;
+
+	/*
+	 * Called once for every variant right after it was compiled, e.g. to bind uniform blocks
+	 */
+	using SetupFunction = std::function<void(Shader &Variant, uint32_t Mask)>;
+
+	ShaderVariants(const std::string &VertexPath, const std::string &FragmentPath, std::vector<std::string> Defines);
+
+	ShaderVariants(const ShaderVariants &) = delete;
+	ShaderVariants &operator=(const ShaderVariants &) = delete;
+
+	void setSetup(SetupFunction Setup) { m_Setup = std::move(Setup); }
+
+	/*
+	 * Returns the variant with the defines selected by Mask, compiling it on first use.
+	 * Needs the GL context, like every other shader creation.
+	 */
+	Shader &get(uint32_t Mask);
+
+	/*
+	 * Number of variants compiled so far
+	 */
+	size_t getCompiledCount() const;
+
+  private:
+	struct Sources
+	{
+		std::string Vertex;
+		std::string Fragment;
+	};
+
+	const Sources &getSources();
+
+	std::string m_VertexPath;
+	std::string m_FragmentPath;
+	std::vector<std::string> m_Defines;
+	SetupFunction m_Setup;
+
+	std::future<Sources> m_PendingSources;
+	Sources m_Sources;
+
+	std::vector<std::unique_ptr<Shader>> m_Variants; // indexed by mask
+};
@@ -0,0 +1,91 @@
+#include "Skeleton.h"
+
+#include "PoseKernel.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+glm::mat4 toGlm(const aiMatrix4x4 &from)
+{
+	// Assimp stores rows contiguously, glm stores columns
+	return glm::transpose(glm::make_mat4(&from.a1));
+}
+
+void Skeleton::build(const aiNode *pRoot)
+{
+	m_Parents.clear();
+	m_SubtreeEnds.clear();
+	m_Names.clear();
+	m_BindTransforms.clear();
+
+	addNode(pRoot, -1);
+
+	m_LocalTransforms = m_BindTransforms;
+	m_GlobalTransforms.resize(m_LocalTransforms.size());
+	updateGlobalTransforms();
+}
+
+void Skeleton::write(utils::BinaryWriter &Writer) const
+{
+	Writer.writeArray(m_Parents);
+	Writer.writeArray(m_SubtreeEnds);
+	Writer.writeArray(m_BindTransforms);
+	for (const auto &Name : m_Names)
+		Writer.writeString(Name);
+}
+
+bool Skeleton::read(utils::BinaryReader &Reader)
+{
+	Reader.readArray(m_Parents);
+	Reader.readArray(m_SubtreeEnds);
+	Reader.readArray(m_BindTransforms);
+	m_Names.resize(m_Parents.size());
+	for (auto &Name : m_Names)
+		Name = Reader.readString();
+
+	if (!Reader.ok() || m_Parents.empty() || m_SubtreeEnds.size() != m_Parents.size() || m_BindTransforms.size() != m_Parents.size())
+		return false;
+
+	// Parents need to precede their children for the linear transform pass
+	for (unsigned int i = 0; i < getNodeCount(); i++)
+	{
+		if (m_Parents[i] >= static_cast<int>(i) || m_SubtreeEnds[i] <= i || m_SubtreeEnds[i] > getNodeCount())
+			return false;
+	}
+
+	m_LocalTransforms = m_BindTransforms;
+	m_GlobalTransforms.resize(m_LocalTransforms.size());
+	updateGlobalTransforms();
+	return true;
+}
+
+void Skeleton::addNode(const aiNode *pNode, int Parent)
+{
+	const unsigned int Index = getNodeCount();
+
+	m_Parents.push_back(Parent);
+	m_SubtreeEnds.push_back(0);
+	m_Names.emplace_back(pNode->mName.C_Str());
+	m_BindTransforms.push_back(toGlm(pNode->mTransformation));
+
+	for (unsigned int i = 0; i < pNode->mNumChildren; i++)
+		addNode(pNode->mChildren[i], static_cast<int>(Index));
+
+	m_SubtreeEnds[Index] = getNodeCount();
+}
+
+void Skeleton::updateGlobalTransforms()
+{
+	// Parents always precede their children, so their global transform is already known
+	pose::localToModel(m_Parents.data(), m_LocalTransforms.data(), m_GlobalTransforms.data(), getNodeCount());
+}
+
+int Skeleton::findNode(const std::string &Name) const
+{
+	for (size_t i = 0; i < m_Names.size(); i++)
+	{
+		if (m_Names[i] == Name)
+			return static_cast<int>(i);
+	}
+
+	return -1;
+}
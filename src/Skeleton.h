@@ -0,0 +1,77 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <assimp/scene.h>
+
+#include "utils/BinaryStream.h"
+
+/*
+ * Flattened node hierarchy. Nodes are stored in depth-first order, so every parent
+ * precedes its children and the descendants of a node form one contiguous range.
+ * Local and model-space transforms live in contiguous arrays indexed by node.
+ */
+class Skeleton
+{
+  public:
+	/*
+	 * Flattens the hierarchy below and including pRoot, local transforms start in bind pose.
+	 */
+	void build(const aiNode *pRoot);
+
+	/*
+	 * Serializes the hierarchy and bind pose, read() restores it in bind pose and returns false on invalid data.
+	 */
+	void write(utils::BinaryWriter &Writer) const;
+	bool read(utils::BinaryReader &Reader);
+
+	/*
+	 * Computes model-space transforms of all nodes from their local transforms in one linear pass.
+	 */
+	void updateGlobalTransforms();
+
+	/*
+	 * Returns index of the first node with given name, -1 if there is none.
+	 */
+	int findNode(const std::string &Name) const;
+
+	unsigned int getNodeCount() const { return static_cast<unsigned int>(m_Parents.size()); }
+
+	/*
+	 * Returns parent index of node i, -1 for the root.
+	 */
+	int getParent(unsigned int i) const { return m_Parents[i]; }
+
+	/*
+	 * Returns one past the index of the last descendant of node i.
+	 */
+	unsigned int getSubtreeEnd(unsigned int i) const { return m_SubtreeEnds[i]; }
+
+	const std::string &getName(unsigned int i) const { return m_Names[i]; }
+
+	const glm::mat4 &getBindTransform(unsigned int i) const { return m_BindTransforms[i]; }
+
+	glm::mat4 *getLocalTransforms() { return m_LocalTransforms.data(); }
+	const glm::mat4 &getLocalTransform(unsigned int i) const { return m_LocalTransforms[i]; }
+
+	const glm::mat4 *getGlobalTransforms() const { return m_GlobalTransforms.data(); }
+	const glm::mat4 &getGlobalTransform(unsigned int i) const { return m_GlobalTransforms[i]; }
+
+  private:
+	void addNode(const aiNode *pNode, int Parent);
+
+	std::vector<int> m_Parents;
+	std::vector<unsigned int> m_SubtreeEnds;
+	std::vector<std::string> m_Names;
+	std::vector<glm::mat4> m_BindTransforms;
+	std::vector<glm::mat4> m_LocalTransforms;
+	std::vector<glm::mat4> m_GlobalTransforms;
+};
+
+/*
+ * Converts a row-major Assimp matrix to a column-major glm matrix.
+ */
+glm::mat4 toGlm(const aiMatrix4x4 &from);
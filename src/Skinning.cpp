@@ -0,0 +1,201 @@
+#include "Skinning.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <algorithm>
+
+void SkinnedMesh::write(utils::BinaryWriter &Writer) const
+{
+	Writer.write(Mesh);
+	Writer.write(NumVertices);
+	Writer.write(InfluenceEnds);
+	Writer.writeArray(RestPositions);
+	Writer.writeArray(RestNormals);
+	Writer.writeArray(BoneIds);
+	Writer.writeArray(Weights);
+}
+
+bool SkinnedMesh::read(utils::BinaryReader &Reader)
+{
+	Mesh = Reader.read<unsigned int>();
+	NumVertices = Reader.read<unsigned int>();
+	for (unsigned int k = 0; k <= MAX_BONE_INFLUENCES; k++)
+		InfluenceEnds[k] = Reader.read<unsigned int>();
+	Reader.readArray(RestPositions);
+	Reader.readArray(RestNormals);
+	Reader.readArray(BoneIds);
+	Reader.readArray(Weights);
+
+	return Reader.ok() && InfluenceEnds[MAX_BONE_INFLUENCES] == NumVertices && RestPositions.size() == NumVertices &&
+		   RestNormals.size() == NumVertices && BoneIds.size() == NumVertices && Weights.size() == NumVertices;
+}
+
+namespace skinning
+{
+
+// Requested number of skinning threads, 0 means the OpenMP default
+static unsigned int ThreadCount = 0;
+
+void buildInfluences(const aiMesh *paiMesh, const std::vector<unsigned int> &MeshBones, SkinnedMesh &Out, std::vector<unsigned int> &Order)
+{
+	const unsigned int NumVertices = paiMesh->mNumVertices;
+
+	std::vector<glm::uvec4> BoneIds(NumVertices, glm::uvec4(0));
+	std::vector<glm::vec4> Weights(NumVertices, glm::vec4(0.0f));
+	std::vector<unsigned int> Counts(NumVertices, 0);
+
+	// Scatter the bone weights into the vertices once, keeping the strongest influences
+	for (unsigned int b = 0; b < paiMesh->mNumBones; b++)
+	{
+		const aiBone *pBone = paiMesh->mBones[b];
+		for (unsigned int i = 0; i < pBone->mNumWeights; i++)
+		{
+			const unsigned int v = pBone->mWeights[i].mVertexId;
+			const float w = pBone->mWeights[i].mWeight;
+			if (w <= 0.0f)
+				continue;
+
+			unsigned int Slot = Counts[v];
+			if (Slot == MAX_BONE_INFLUENCES)
+			{
+				// Replace the weakest influence if this one is stronger
+				Slot = 0;
+				for (unsigned int j = 1; j < MAX_BONE_INFLUENCES; j++)
+				{
+					if (Weights[v][j] < Weights[v][Slot])
+						Slot = j;
+				}
+
+				if (Weights[v][Slot] >= w)
+					continue;
+			}
+			else
+			{
+				Counts[v]++;
+			}
+
+			BoneIds[v][Slot] = MeshBones[b];
+			Weights[v][Slot] = w;
+		}
+	}
+
+	// Counting sort of the vertices by their number of influences
+	unsigned int GroupStarts[MAX_BONE_INFLUENCES + 1] = {};
+	for (unsigned int k = 0; k <= MAX_BONE_INFLUENCES; k++)
+		Out.InfluenceEnds[k] = 0;
+	for (unsigned int v = 0; v < NumVertices; v++)
+		Out.InfluenceEnds[Counts[v]]++;
+	for (unsigned int k = 1; k <= MAX_BONE_INFLUENCES; k++)
+	{
+		GroupStarts[k] = Out.InfluenceEnds[k - 1];
+		Out.InfluenceEnds[k] += Out.InfluenceEnds[k - 1];
+	}
+
+	Order.resize(NumVertices);
+	for (unsigned int v = 0; v < NumVertices; v++)
+		Order[GroupStarts[Counts[v]]++] = v;
+
+	Out.NumVertices = NumVertices;
+	Out.RestPositions.resize(NumVertices);
+	Out.RestNormals.resize(NumVertices);
+	Out.BoneIds.resize(NumVertices);
+	Out.Weights.resize(NumVertices);
+
+	for (unsigned int n = 0; n < NumVertices; n++)
+	{
+		const unsigned int v = Order[n];
+		const aiVector3D &Position = paiMesh->mVertices[v];
+		const aiVector3D &Normal = paiMesh->mNormals[v];
+
+		Out.RestPositions[n] = glm::vec3(Position.x, Position.y, Position.z);
+		Out.RestNormals[n] = glm::vec3(Normal.x, Normal.y, Normal.z);
+		Out.BoneIds[n] = BoneIds[v];
+
+		const float Total = Weights[v].x + Weights[v].y + Weights[v].z + Weights[v].w;
+		Out.Weights[n] = Total > 0.0f ? Weights[v] / Total : Weights[v];
+	}
+}
+
+/// Skins vertices [Begin, End) which all have exactly Count influences
+template <unsigned int Count>
+static void skinGroup(const SkinnedMesh &Mesh, const glm::mat4 *Palette, unsigned int Begin, unsigned int End, glm::vec3 *Positions, glm::vec3 *Normals)
+{
+	for (unsigned int v = Begin; v < End; v++)
+	{
+		const glm::uvec4 &Ids = Mesh.BoneIds[v];
+		const glm::vec4 &Weights = Mesh.Weights[v];
+
+		// Blend the bone matrices first, so every vertex is transformed only once
+		glm::mat4 Skin = Palette[Ids[0]] * Weights[0];
+		for (unsigned int j = 1; j < Count; j++)
+			Skin += Palette[Ids[j]] * Weights[j];
+
+		Positions[v] = glm::vec3(Skin * glm::vec4(Mesh.RestPositions[v], 1.0f));
+		Normals[v] = glm::mat3(Skin) * Mesh.RestNormals[v];
+	}
+}
+
+void skin(const SkinnedMesh &Mesh, const glm::mat4 *Palette, glm::vec3 *Positions, glm::vec3 *Normals)
+{
+	skinRange(Mesh, Palette, 0, Mesh.NumVertices, Positions, Normals);
+}
+
+void skinRange(const SkinnedMesh &Mesh, const glm::mat4 *Palette, unsigned int Begin, unsigned int End, glm::vec3 *Positions, glm::vec3 *Normals)
+{
+	static_assert(MAX_BONE_INFLUENCES == 4, "skinRange() expects vertices with up to 4 influences");
+
+	// Clamp every influence group to the requested range
+	unsigned int Ends[MAX_BONE_INFLUENCES + 1];
+	for (unsigned int k = 0; k <= MAX_BONE_INFLUENCES; k++)
+		Ends[k] = std::min(std::max(Mesh.InfluenceEnds[k], Begin), End);
+
+	// Vertices without influences keep their rest pose
+	for (unsigned int v = Begin; v < Ends[0]; v++)
+	{
+		Positions[v] = Mesh.RestPositions[v];
+		Normals[v] = Mesh.RestNormals[v];
+	}
+
+	skinGroup<1>(Mesh, Palette, Ends[0], Ends[1], Positions, Normals);
+	skinGroup<2>(Mesh, Palette, Ends[1], Ends[2], Positions, Normals);
+	skinGroup<3>(Mesh, Palette, Ends[2], Ends[3], Positions, Normals);
+	skinGroup<4>(Mesh, Palette, Ends[3], Ends[4], Positions, Normals);
+}
+
+void skinMeshes(const SkinnedMesh *Meshes, unsigned int Count, const glm::mat4 *Palette, glm::vec3 *const *Positions, glm::vec3 *const *Normals)
+{
+	// Threads do not wait at the end of a mesh, so small meshes are spread over
+	// the threads together with the chunks of the following ones
+#pragma omp parallel num_threads(getThreadCount())
+	for (unsigned int m = 0; m < Count; m++)
+	{
+		const SkinnedMesh &Mesh = Meshes[m];
+		const int NumChunks = static_cast<int>((Mesh.NumVertices + SKINNING_CHUNK_SIZE - 1) / SKINNING_CHUNK_SIZE);
+
+#pragma omp for schedule(static) nowait
+		for (int c = 0; c < NumChunks; c++)
+		{
+			const unsigned int Begin = static_cast<unsigned int>(c) * SKINNING_CHUNK_SIZE;
+			const unsigned int End = std::min(Begin + SKINNING_CHUNK_SIZE, Mesh.NumVertices);
+			skinRange(Mesh, Palette, Begin, End, Positions[m], Normals[m]);
+		}
+	}
+}
+
+void setThreadCount(unsigned int Count)
+{
+	ThreadCount = Count;
+}
+
+unsigned int getThreadCount()
+{
+#ifdef _OPENMP
+	return ThreadCount > 0 ? ThreadCount : static_cast<unsigned int>(omp_get_max_threads());
+#else
+	return 1;
+#endif
+}
+
+} // namespace skinning
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <assimp/scene.h>
+
+#include "utils/BinaryStream.h"
+
+// Maximum number of bones influencing a single vertex, weakest influences beyond this are dropped
+constexpr unsigned int MAX_BONE_INFLUENCES = 4;
+// Number of consecutive vertices skinned by one thread at a time
+constexpr unsigned int SKINNING_CHUNK_SIZE = 2048;
+
+/*
+ * Rest pose and fixed-width bone influences of a skinned mesh. Vertices are sorted
+ * by their number of influences, so the skinning kernel runs without per-vertex branches.
+ */
+struct SkinnedMesh
+{
+	// Index of the mesh entry this skin belongs to
+	unsigned int Mesh = 0;
+	unsigned int NumVertices = 0;
+
+	std::vector<glm::vec3> RestPositions;
+	std::vector<glm::vec3> RestNormals;
+	// Indices into the bone palette and their normalized weights, unused slots have weight 0
+	std::vector<glm::uvec4> BoneIds;
+	std::vector<glm::vec4> Weights;
+
+	// Vertices [InfluenceEnds[k - 1], InfluenceEnds[k]) have k influences, the range for k = 0 starts at 0
+	unsigned int InfluenceEnds[MAX_BONE_INFLUENCES + 1] = {};
+
+	/*
+	 * Serializes the skin, read() restores it and returns false on invalid data.
+	 */
+	void write(utils::BinaryWriter &Writer) const;
+	bool read(utils::BinaryReader &Reader);
+};
+
+namespace skinning
+{
+
+/*
+ * Converts the per-bone vertex weights of paiMesh into a per-vertex influence table.
+ * @param paiMesh		Mesh to convert
+ * @param MeshBones		Maps bone i of paiMesh to its index in the bone palette
+ * @param Out			Skin to fill, vertices are stored in sorted order
+ * @param Order			Receives the original vertex index of each sorted vertex
+ */
+void buildInfluences(const aiMesh *paiMesh, const std::vector<unsigned int> &MeshBones, SkinnedMesh &Out, std::vector<unsigned int> &Order);
+
+/*
+ * Linear blend skinning of all vertices of Mesh. Every vertex is read once and its
+ * position and normal are written once, in order.
+ * @param Mesh			Skin to transform
+ * @param Palette		Model-space bone matrices including their offset matrices
+ * @param Positions		Output positions, Mesh.NumVertices elements
+ * @param Normals		Output normals, Mesh.NumVertices elements
+ */
+void skin(const SkinnedMesh &Mesh, const glm::mat4 *Palette, glm::vec3 *Positions, glm::vec3 *Normals);
+
+/*
+ * Same as skin() but only transforms vertices [Begin, End). Positions and Normals still
+ * point to the first vertex of the mesh.
+ */
+void skinRange(const SkinnedMesh &Mesh, const glm::mat4 *Palette, unsigned int Begin, unsigned int End, glm::vec3 *Positions, glm::vec3 *Normals);
+
+/*
+ * Skins Count meshes, splitting their vertices into chunks of SKINNING_CHUNK_SIZE
+ * which are distributed over getThreadCount() threads. Every vertex is written by exactly
+ * one thread, so the result does not depend on the number of threads.
+ * @param Meshes		Skins to transform
+ * @param Count			Number of skins
+ * @param Palette		Model-space bone matrices including their offset matrices
+ * @param Positions		Output positions, one array per mesh
+ * @param Normals		Output normals, one array per mesh
+ */
+void skinMeshes(const SkinnedMesh *Meshes, unsigned int Count, const glm::mat4 *Palette, glm::vec3 *const *Positions, glm::vec3 *const *Normals);
+
+/*
+ * Sets number of threads used by skinMeshes, 0 uses the OpenMP default.
+ * Has no effect when built without OpenMP.
+ */
+void setThreadCount(unsigned int Count);
+unsigned int getThreadCount();
+
+} // namespace skinning
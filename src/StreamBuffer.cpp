@@ -0,0 +1,113 @@
+#include "StreamBuffer.h"
+
+#include "utils/Logger.h"
+
+// Regions start at multiples of this, which satisfies every buffer binding alignment
+constexpr GLsizeiptr REGION_ALIGNMENT = 256;
+
+StreamBuffer::~StreamBuffer()
+{
+	clear();
+}
+
+bool StreamBuffer::init(GLsizeiptr RegionSize, unsigned int RegionCount)
+{
+	clear();
+
+	m_RegionSize = (RegionSize + REGION_ALIGNMENT - 1) / REGION_ALIGNMENT * REGION_ALIGNMENT;
+	m_Region = 0;
+	m_Fenced = false;
+	m_Fences.assign(RegionCount, nullptr);
+
+	const GLsizeiptr Size = m_RegionSize * RegionCount;
+	glCreateBuffers(1, &m_Buffer);
+
+	m_Persistent = GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+	if (m_Persistent)
+	{
+		// Coherent writes become visible to the GPU without explicit flushes
+		const GLbitfield Flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glNamedBufferStorage(m_Buffer, Size, nullptr, Flags);
+		m_Mapped = static_cast<char *>(glMapNamedBufferRange(m_Buffer, 0, Size, Flags));
+		if (!m_Mapped)
+		{
+			WARNING("Could not map stream buffer persistently");
+			clear();
+			return false;
+		}
+	}
+	else
+	{
+		glNamedBufferData(m_Buffer, Size, nullptr, GL_STREAM_DRAW);
+	}
+
+	return true;
+}
+
+void StreamBuffer::clear()
+{
+	for (auto &Fence : m_Fences)
+	{
+		if (Fence)
+			glDeleteSync(Fence);
+		Fence = nullptr;
+	}
+
+	if (m_Buffer != 0)
+	{
+		if (m_Persistent && m_Mapped)
+			glUnmapNamedBuffer(m_Buffer);
+		glDeleteBuffers(1, &m_Buffer);
+		m_Buffer = 0;
+	}
+
+	m_Mapped = nullptr;
+}
+
+void *StreamBuffer::map()
+{
+	if (m_Fenced)
+	{
+		m_Region = (m_Region + 1) % m_Fences.size();
+		m_Fenced = false;
+	}
+
+	// Wait until the GPU finished the commands that last read this region
+	GLsync &Fence = m_Fences[m_Region];
+	if (Fence)
+	{
+		GLenum Result = glClientWaitSync(Fence, 0, 0);
+		while (Result == GL_TIMEOUT_EXPIRED)
+			Result = glClientWaitSync(Fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+
+		glDeleteSync(Fence);
+		Fence = nullptr;
+	}
+
+	if (m_Persistent)
+		return m_Mapped + getRegionOffset();
+
+	// The fence already guarantees the region is idle, so the driver does not need to synchronize
+	const GLbitfield Flags = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+	m_Mapped = static_cast<char *>(glMapNamedBufferRange(m_Buffer, getRegionOffset(), m_RegionSize, Flags));
+	return m_Mapped;
+}
+
+void StreamBuffer::unmap()
+{
+	if (!m_Persistent && m_Mapped)
+	{
+		glUnmapNamedBuffer(m_Buffer);
+		m_Mapped = nullptr;
+	}
+}
+
+void StreamBuffer::fence()
+{
+	GLsync &Fence = m_Fences[m_Region];
+	if (Fence)
+		glDeleteSync(Fence);
+
+	Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	m_Fenced = true;
+}
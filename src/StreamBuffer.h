@@ -0,0 +1,73 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <vector>
+
+/*
+ * Ring of equally sized regions in one buffer object, used to stream data the CPU rewrites
+ * every frame. The buffer is mapped persistently when glBufferStorage is available,
+ * otherwise every region is mapped unsynchronized while it is written. Every region is
+ * guarded by a fence, so the CPU only waits when it is RegionCount frames ahead of the GPU.
+ */
+class StreamBuffer
+{
+  public:
+	StreamBuffer() = default;
+	~StreamBuffer();
+
+	StreamBuffer(const StreamBuffer &) = delete;
+	StreamBuffer &operator=(const StreamBuffer &) = delete;
+
+	/**
+	 * Creates the buffer, previous contents are released
+	 * @param RegionSize 	Size of a single region in bytes
+	 * @param RegionCount 	Number of regions, the number of frames that may be in flight
+	 * @return 				False if the buffer could not be created or mapped
+	 */
+	bool init(GLsizeiptr RegionSize, unsigned int RegionCount = 3);
+
+	/**
+	 * Releases the buffer and its fences
+	 */
+	void clear();
+
+	/**
+	 * Returns pointer to the region written this frame, waiting for the GPU if it still reads it.
+	 * Moves to the next region only if the current one was fenced, so calling it twice before
+	 * fence() returns the same region.
+	 */
+	void *map();
+
+	/**
+	 * Finishes writing the current region, needs to be called before it is drawn from
+	 */
+	void unmap();
+
+	/**
+	 * Marks the current region as in use by all commands submitted so far
+	 */
+	void fence();
+
+	GLuint getBuffer() const { return m_Buffer; }
+	GLsizeiptr getRegionSize() const { return m_RegionSize; }
+
+	/**
+	 * Returns byte offset of the current region in the buffer
+	 */
+	GLintptr getRegionOffset() const { return m_RegionSize * m_Region; }
+
+	/**
+	 * Whether the buffer is mapped persistently, otherwise each region is mapped in map()
+	 */
+	bool isPersistent() const { return m_Persistent; }
+
+  private:
+	GLuint m_Buffer = 0;
+	GLsizeiptr m_RegionSize = 0;
+	unsigned int m_Region = 0;
+	bool m_Fenced = false;
+	bool m_Persistent = false;
+	char *m_Mapped = nullptr;
+	std::vector<GLsync> m_Fences;
+};
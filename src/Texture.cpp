@@ -2,38 +2,79 @@
 
 #include "Texture.h"
 
+#include "PixelConvert.h"
 #include "utils/File.h"
+#include "utils/Hash.h"
 #include "utils/Logger.h"
+#include "utils/MappedFile.h"
+#include "utils/Timer.h"
 
 #include <FreeImage.h>
+#include <algorithm>
+#include <atomic>
 #include <fstream>
 #include <iostream>
 #include <vector>
 #include <cmath>
 
+// Cooked textures are stored next to their source with this extension
+constexpr const char *COOKED_EXTENSION = ".bcn";
+
+static std::atomic<bool> CompressionEnabled(true);
+
+void Texture::setCompression(bool Enabled)
+{
+	CompressionEnabled = Enabled;
+}
+
 Texture::Texture(GLenum TextureTarget, const std::string &FileName)
 	: m_FileName(FileName), m_TextureObj(0), m_TextureTarget(TextureTarget)
 {
 }
 
+Texture::~Texture()
+{
+	if (m_TextureObj)
+		glDeleteTextures(1, &m_TextureObj);
+}
+
 bool Texture::load()
 {
-	// Generate texture object
-	glGenTextures(1, &m_TextureObj);
-	glBindTexture(m_TextureTarget, m_TextureObj);
+	const bool decoded = decode();
+	upload();
+	return decoded;
+}
 
-	// Set initial data in case texture loading fails
-	constexpr int dummyData = 2147483627 + 20;
-	glTexImage2D(m_TextureTarget, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, &dummyData);
-	unbind();
+bool Texture::decode()
+{
+	m_Pixels.clear();
+	m_Compressed = bcn::CompressedImage();
+	m_Width = 0;
+	m_Height = 0;
+	m_SizeInBytes = 0;
 
 	// Check if file actually exists
-	if (!utils::file::exists(m_FileName))
+	utils::MappedFile Source(m_FileName);
+	if (!Source.isOpen())
 	{
 		DEBUG("Could not open file: %s", m_FileName.c_str());
 		return false;
 	}
 
+	// Use the cooked copy if it was made from the current source, uncompressed textures never need the hash
+	const bool Compress = CompressionEnabled;
+	const std::string CookedPath = m_FileName + COOKED_EXTENSION;
+	const uint64_t SourceHash = Compress ? utils::hash::fnv1a(Source.data(), Source.size()) : 0;
+	Source.close();
+	if (Compress && bcn::load(CookedPath, SourceHash, m_Compressed))
+	{
+		m_Width = m_Compressed.getWidth();
+		m_Height = m_Compressed.getHeight();
+		m_SizeInBytes = m_Compressed.Data.size();
+		DEBUG("Loaded cooked texture '%s'", CookedPath.c_str());
+		return true;
+	}
+
 	// Get file type using FreeImage
 	const char *filename = m_FileName.c_str();
 	FREE_IMAGE_FORMAT type = FIF_UNKNOWN;
@@ -43,6 +84,11 @@ bool Texture::load()
 
 	// Load image from disk and convert to 32 bits
 	FIBITMAP *tmp = FreeImage_Load(type, filename);
+	if (!tmp)
+	{
+		DEBUG("Could not decode file: %s", m_FileName.c_str());
+		return false;
+	}
 	FIBITMAP *image = FreeImage_ConvertTo32Bits(tmp);
 
 	// Unload image in original format
@@ -54,42 +100,107 @@ bool Texture::load()
 	// Initialize an array of values
 	std::vector<unsigned int> colors(width * height);
 
-	// Loop over every pixel
-	for (unsigned int y = 0; y < height; y++)
+	// Convert whole scanlines to RGBA, rows start at the bottom like glTexImage2D expects
+	utils::Timer timer;
+#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
+	pixels::bgraToRgba(FreeImage_GetBits(image), FreeImage_GetPitch(image), colors.data(), width, height);
+#else
+	pixels::copyRows(FreeImage_GetBits(image), FreeImage_GetPitch(image), colors.data(), width, height);
+#endif
+	DEBUG("Converted %ux%u pixels of '%s' at %.0f MB/s", width, height, m_FileName.c_str(),
+		  colors.size() * sizeof(unsigned int) / (1024.0 * 1024.0) / std::max(timer.elapsedMs() / 1000.0, 1e-6));
+
+	// Unload FreeImage object, not needed anymore
+	FreeImage_Unload(image);
+
+	m_Width = width;
+	m_Height = height;
+	if (!Compress)
 	{
-		for (unsigned int x = 0; x < width; x++)
+		m_Pixels = std::move(colors);
+		m_SizeInBytes = m_Pixels.size() * sizeof(unsigned int);
+		return true;
+	}
+
+	// Cook the full mip chain once, later loads read it from disk
+	timer.reset();
+	const bcn::Format Encoding = bcn::hasAlpha(colors.data(), colors.size()) ? bcn::Format::BC3 : bcn::Format::BC1;
+	bcn::compress(colors.data(), width, height, Encoding, m_Compressed);
+	m_SizeInBytes = m_Compressed.Data.size();
+	DEBUG("Cooked '%s' to %s with %zu levels in %.1f ms, %.1f MB -> %.1f MB", m_FileName.c_str(), Encoding == bcn::Format::BC1 ? "BC1" : "BC3",
+		  m_Compressed.Levels.size(), timer.elapsedMs(), colors.size() * sizeof(unsigned int) / (1024.0 * 1024.0), m_SizeInBytes / (1024.0 * 1024.0));
+
+	if (!bcn::save(CookedPath, SourceHash, m_Compressed))
+		WARNING("Could not write cooked texture '%s'", CookedPath.c_str());
+	return true;
+}
+
+void Texture::upload()
+{
+	// Shared textures are uploaded by their first user
+	if (m_Uploaded)
+		return;
+	m_Uploaded = true;
+
+	// Generate texture object
+	if (!m_TextureObj)
+		glGenTextures(1, &m_TextureObj);
+	glBindTexture(m_TextureTarget, m_TextureObj);
+
+	// Cooked mip levels are uploaded as they are, no mip-maps have to be generated
+	if (!m_Compressed.Levels.empty())
+	{
+		const GLenum Format = m_Compressed.Encoding == bcn::Format::BC1 ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		for (size_t i = 0; i < m_Compressed.Levels.size(); i++)
 		{
-			// Retrieve data from current pixel
-			RGBQUAD quad;
-			FreeImage_GetPixelColor(image, x, y, &quad);
-			const auto red = (unsigned int)(quad.rgbRed);
-			const auto blue = (unsigned int)(quad.rgbBlue);
-			const auto green = (unsigned int)(quad.rgbGreen);
-			const auto alpha = (unsigned int)(quad.rgbReserved);
-
-			// Convert to our own format
-			colors[x + y * width] = (red << 0) | (blue << 8) | (green << 16) | (alpha << 24);
+			const bcn::MipLevel &Level = m_Compressed.Levels[i];
+			glCompressedTexImage2D(m_TextureTarget, static_cast<GLint>(i), Format, Level.Width, Level.Height, 0, static_cast<GLsizei>(Level.Size),
+								   m_Compressed.Data.data() + Level.Offset);
 		}
+		glTexParameteri(m_TextureTarget, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(m_Compressed.Levels.size() - 1));
+		setParameters();
+		unbind();
+
+		m_Compressed = bcn::CompressedImage();
+		return;
 	}
 
-	// Unload FreeImage object, not needed anymore
-	FreeImage_Unload(image);
+	// Set initial data in case texture loading failed
+	if (m_Pixels.empty())
+	{
+		constexpr int dummyData = 2147483627 + 20;
+		glTexImage2D(m_TextureTarget, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, &dummyData);
+		unbind();
+		return;
+	}
 
-	// Bind current texture object
-	glBindTexture(m_TextureTarget, m_TextureObj);
 	// Update its data to image data
-	glTexImage2D(m_TextureTarget, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, colors.data());
+	glTexImage2D(m_TextureTarget, 0, GL_RGBA, m_Width, m_Height, 0, GL_RGBA, GL_UNSIGNED_BYTE, m_Pixels.data());
 	// Generate mip-map levels
 	glGenerateMipmap(m_TextureTarget);
-	// Set clamping and filtering methods
+	setParameters();
+
+	unbind();
+
+	// The pixels live on the GPU now
+	m_Pixels.clear();
+	m_Pixels.shrink_to_fit();
+}
+
+void Texture::setParameters()
+{
+	// Set clamping and filtering methods, both upload paths provide a full mip chain
 	glTexParameteri(m_TextureTarget, GL_TEXTURE_WRAP_S, GL_REPEAT);
 	glTexParameteri(m_TextureTarget, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(m_TextureTarget, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(m_TextureTarget, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 	glTexParameteri(m_TextureTarget, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
 
-	unbind();
-	// Texture loaded successfully
-	return true;
+uint64_t Texture::hashPixels() const
+{
+	if (!m_Compressed.Levels.empty())
+		return utils::hash::fnv1a(m_Compressed.Data.data(), m_Compressed.Data.size());
+	return utils::hash::fnv1a(m_Pixels.data(), m_Pixels.size() * sizeof(unsigned int));
 }
 
 void Texture::bind()
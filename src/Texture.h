@@ -2,7 +2,11 @@
 
 #include <GL/glew.h>
 
+#include "BlockCompress.h"
+
+#include <cstdint>
 #include <string>
+#include <vector>
 
 class Texture
 {
@@ -13,13 +17,50 @@ class Texture
   	 * @param FileName 			File to load
   	 */
 	Texture(GLenum TextureTarget, const std::string &FileName);
+	~Texture();
+
+	Texture(const Texture &) = delete;
+	Texture &operator=(const Texture &) = delete;
 
 	/**
-	 * Load texture from filesystem
+	 * Load texture from filesystem, same as decode() followed by upload()
 	 * @return
 	 */
 	bool load();
 
+	/**
+	 * Reads and converts the image, does not touch OpenGL so it can run on any thread.
+	 * With compression enabled the image is read from its cooked block compressed copy,
+	 * which is created from the source the first time.
+	 * @return 	False if the file could not be read
+	 */
+	bool decode();
+
+	/**
+	 * Creates the OpenGL texture from the decoded image, a 1x1 placeholder if decoding failed.
+	 * Does nothing if the texture was already uploaded.
+	 */
+	void upload();
+
+	/**
+	 * Hash of the decoded pixels or blocks, only valid before upload()
+	 */
+	uint64_t hashPixels() const;
+
+	unsigned int getWidth() const { return m_Width; }
+	unsigned int getHeight() const { return m_Height; }
+
+	/**
+	 * Size of the decoded image in bytes including cooked mip levels, 0 if decoding failed
+	 */
+	size_t getSizeInBytes() const { return m_SizeInBytes; }
+
+	/**
+	 * Whether decode() cooks textures into BC1/BC3 blocks, needs EXT_texture_compression_s3tc
+	 * @param Enabled 	Use compressed textures, enabled by default
+	 */
+	static void setCompression(bool Enabled);
+
 	/**
 	 * Bind texture
 	 */
@@ -37,7 +78,22 @@ class Texture
 	void unbind();
 
   private:
+	/**
+	 * Sets wrapping and filtering of the bound texture
+	 */
+	void setParameters();
+
 	std::string m_FileName;
 	GLenum m_TextureTarget;
 	GLuint m_TextureObj;
+	bool m_Uploaded = false;
+
+	// Decoded RGBA pixels waiting for upload()
+	std::vector<unsigned int> m_Pixels;
+	unsigned int m_Width = 0;
+	unsigned int m_Height = 0;
+	size_t m_SizeInBytes = 0;
+
+	// Cooked mip chain, replaces m_Pixels when compression is enabled
+	bcn::CompressedImage m_Compressed;
 };
\ No newline at end of file
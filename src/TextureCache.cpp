@@ -0,0 +1,104 @@
+#include "TextureCache.h"
+
+#include "utils/File.h"
+#include "utils/Hash.h"
+#include "utils/Logger.h"
+
+#include <map>
+#include <mutex>
+#include <tuple>
+
+namespace textures
+{
+
+// Identifies decoded images by size and pixel hash
+using ContentKey = std::tuple<unsigned int, unsigned int, uint64_t>;
+
+static std::mutex CacheMutex;
+static std::map<std::string, std::weak_ptr<Texture>> ByPath;
+static std::map<ContentKey, std::weak_ptr<Texture>> ByContent;
+static CacheStats Stats;
+
+/// Drops entries whose textures were released, e.g. by an earlier model. Expects CacheMutex to be held.
+template <typename Map>
+static void pruneExpired(Map &Entries)
+{
+	for (auto It = Entries.begin(); It != Entries.end();)
+	{
+		if (It->second.expired())
+			It = Entries.erase(It);
+		else
+			++It;
+	}
+}
+
+std::shared_ptr<Texture> acquire(const std::string &Path)
+{
+	const std::string Canonical = utils::file::canonical(Path);
+
+	{
+		std::lock_guard<std::mutex> Lock(CacheMutex);
+		const auto Found = ByPath.find(Canonical);
+		if (auto Cached = Found != ByPath.end() ? Found->second.lock() : nullptr)
+		{
+			Stats.Hits++;
+			Stats.BytesSaved += Cached->getSizeInBytes();
+			DEBUG("Reusing texture '%s'", Canonical.c_str());
+			return Cached;
+		}
+
+		// Misses are rare and followed by a decode, so this is the place to clean up
+		pruneExpired(ByPath);
+		pruneExpired(ByContent);
+	}
+
+	// Decode without holding the lock, so several loaders can decode at the same time
+	auto Decoded = std::make_shared<Texture>(GL_TEXTURE_2D, Canonical);
+	if (!Decoded->decode())
+		WARNING("Error loading texture '%s'", Canonical.c_str());
+
+	const ContentKey Content(Decoded->getWidth(), Decoded->getHeight(), Decoded->hashPixels());
+
+	std::lock_guard<std::mutex> Lock(CacheMutex);
+	Stats.Misses++;
+
+	// Another loader may have finished the same file in the meantime
+	std::weak_ptr<Texture> &Entry = ByPath[Canonical];
+	if (auto Cached = Entry.lock())
+		return Cached;
+
+	if (Decoded->getSizeInBytes() > 0)
+	{
+		std::weak_ptr<Texture> &SameContent = ByContent[Content];
+		if (auto Cached = SameContent.lock())
+		{
+			Stats.Duplicates++;
+			Stats.BytesSaved += Cached->getSizeInBytes();
+			DEBUG("Texture '%s' has the same pixels as an already loaded one", Canonical.c_str());
+			Entry = Cached;
+			return Cached;
+		}
+		SameContent = Decoded;
+	}
+
+	DEBUG("Loaded texture '%s'", Canonical.c_str());
+	Entry = Decoded;
+	return Decoded;
+}
+
+CacheStats getStats()
+{
+	std::lock_guard<std::mutex> Lock(CacheMutex);
+	return Stats;
+}
+
+void logStats()
+{
+#ifndef NDEBUG
+	const CacheStats Current = getStats();
+	DEBUG("Texture cache: %zu hits, %zu misses, %zu duplicates, %.1f MB saved", Current.Hits, Current.Misses, Current.Duplicates,
+		  Current.BytesSaved / (1024.0 * 1024.0));
+#endif
+}
+
+} // namespace textures
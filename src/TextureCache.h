@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "Texture.h"
+
+/*
+ * Process-wide texture cache. Textures are shared by every model referencing the same file
+ * or the same decoded image, and are destroyed once the last handle to them is released.
+ */
+namespace textures
+{
+
+struct CacheStats
+{
+	// Requests served by a texture with the same canonical path
+	size_t Hits = 0;
+	// Requests that had to decode the file
+	size_t Misses = 0;
+	// Decoded files whose pixels matched an already cached texture
+	size_t Duplicates = 0;
+	// Decoded bytes not uploaded again thanks to hits and duplicates
+	size_t BytesSaved = 0;
+};
+
+/*
+ * Returns the texture for given file, decoding it if no live texture has the same path or
+ * pixels. The texture still needs Texture::upload() on the OpenGL thread, which does nothing
+ * if it already happened. Safe to call from any thread.
+ */
+std::shared_ptr<Texture> acquire(const std::string &Path);
+
+CacheStats getStats();
+
+/*
+ * Logs hits, misses and saved bytes.
+ */
+void logStats();
+
+} // namespace textures
@@ -1,34 +1,247 @@
 #include "VideoPlayer.h"
 
+#include "utils/File.h"
+#include "utils/Hash.h"
 #include "utils/Logger.h"
+#include "utils/Timer.h"
 
-VideoPlayer::VideoPlayer(const char *file_name, int start_frame, int end_frame)
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+constexpr const char *PROXY_EXTENSION = ".proxy";
+constexpr uint32_t PROXY_MAGIC = 0x58525056; // "VPRX"
+constexpr uint32_t PROXY_VERSION = 2;
+// Frames start on a page boundary after the header.
+constexpr size_t PROXY_DATA_OFFSET = 4096;
+
+// Seek requests hold the generation in the upper 24 bits, the stride in the next 8 and the frame in the lower 32.
+static uint64_t packRequest(uint32_t generation, int stride, int frame)
+{
+	return (static_cast<uint64_t>(generation & 0xFFFFFF) << 40) | (static_cast<uint64_t>(stride & 0xFF) << 32) | static_cast<uint32_t>(frame);
+}
+
+static uint32_t requestGeneration(uint64_t request)
+{
+	return static_cast<uint32_t>(request >> 40);
+}
+
+static int requestStride(uint64_t request)
+{
+	return static_cast<int>((request >> 32) & 0xFF);
+}
+
+static int requestFrame(uint64_t request)
+{
+	return static_cast<int>(static_cast<uint32_t>(request));
+}
+
+VideoPlayer::VideoPlayer(const char *file_name, int start_frame, int end_frame, float proxy_scale)
 	: m_File(file_name), m_StartFrame(start_frame), m_EndFrame(end_frame)
 {
 	initialize();
 
-	// Create OpenGL texture.
-	glCreateTextures(GL_TEXTURE_2D, 1, &m_TexID);
-
 	// Get initial frame to be able to read width and height of video.
 	cv::Mat image;
-	m_Capture >> image;
+	if (proxy_scale > 0.0f && openProxy(proxy_scale))
+	{
+		image = cv::Mat(m_ProxyHeader.Height, m_ProxyHeader.Width, CV_8UC3, const_cast<char *>(m_Proxy.data() + PROXY_DATA_OFFSET));
+	}
+	else
+	{
+		m_Capture >> image;
+		m_Capture.set(CV_CAP_PROP_POS_FRAMES, 0);
+	}
 
-	// Set initial frame to 0.
-	reset();
+	// Create OpenGL texture for the whole frame.
+	m_FrameSize = image.size();
+	m_Crop = cv::Rect(cv::Point(0, 0), m_FrameSize);
+	createTexture();
 
-	// Set texture format.
-	glTextureStorage2D(m_TexID, 1, GL_RGB8, image.cols, image.rows);
-	glTextureParameteri(m_TexID, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTextureParameteri(m_TexID, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	if (image.empty())
+		return;
+
+	// Retrieved frames are kept within a fixed memory budget.
+	m_FrameCache.setCapacity(std::max<size_t>(FRAME_CACHE_BYTES / (image.total() * image.elemSize()), 1));
+
+	// Allocate all frames up front, the decoder writes into them in place.
+	m_Request = packRequest(0, PLAYBACK_STRIDE, m_StartFrame);
+	if (!initPixelBuffer(image))
+	{
+		for (auto &frame : m_Frames.slots())
+			frame.Image.create(image.rows, image.cols, image.type());
+	}
+
+	// Start decoding ahead from the first frame of the played range.
+	m_Running = true;
+	m_Decoder = std::thread(&VideoPlayer::decodeLoop, this);
 }
 
 VideoPlayer::~VideoPlayer()
 {
+	// Stop decoding before the capture goes away.
+	m_Running = false;
+	if (m_Decoder.joinable())
+		m_Decoder.join();
+
 	// Release OpenCV video object.
 	m_Capture.release();
 	// Delete texture.
 	glDeleteTextures(1, &m_TexID);
+
+	// Delete pixel buffer, its mapping ends with it.
+	if (m_UploadFence)
+		glDeleteSync(m_UploadFence);
+	if (m_UploadQuery)
+		glDeleteQueries(1, &m_UploadQuery);
+	if (m_PixelBuffer)
+		glDeleteBuffers(1, &m_PixelBuffer);
+}
+
+bool VideoPlayer::initPixelBuffer(const cv::Mat &image)
+{
+	if (!(GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage) || !image.isContinuous())
+		return false;
+
+	// Regions start at multiples of 256 bytes, which satisfies any unpack alignment.
+	const GLsizeiptr frameSize = static_cast<GLsizeiptr>(image.total() * image.elemSize());
+	const GLsizeiptr regionSize = (frameSize + 255) / 256 * 256;
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	glCreateBuffers(1, &m_PixelBuffer);
+	glNamedBufferStorage(m_PixelBuffer, regionSize * FRAME_RING_SIZE, nullptr, flags);
+	auto mapped = static_cast<unsigned char *>(glMapNamedBufferRange(m_PixelBuffer, 0, regionSize * FRAME_RING_SIZE, flags));
+	if (!mapped)
+	{
+		WARNING("Could not map video pixel buffer, uploading from client memory.");
+		glDeleteBuffers(1, &m_PixelBuffer);
+		m_PixelBuffer = 0;
+		return false;
+	}
+
+	// The decoder converts every frame straight into its region, there is no staging copy.
+	GLintptr offset = 0;
+	for (auto &frame : m_Frames.slots())
+	{
+		frame.Mapped = mapped + offset;
+		frame.Offset = offset;
+		frame.Image = cv::Mat(image.rows, image.cols, image.type(), frame.Mapped);
+		offset += regionSize;
+	}
+
+	glCreateQueries(GL_TIME_ELAPSED, 1, &m_UploadQuery);
+	return true;
+}
+
+bool VideoPlayer::openProxy(float scale)
+{
+	// The proxy belongs to the video file, range and scale it was made from. Size and modification
+	// time identify the file, hashing the whole video would cost more than loading the proxy.
+	uint64_t size = 0;
+	int64_t modified = 0;
+	if (!utils::file::getInfo(m_File, size, modified))
+		return false;
+
+	const int32_t settings[] = {m_StartFrame, m_EndFrame};
+	uint64_t sourceHash = utils::hash::fnv1a(&size, sizeof(size));
+	sourceHash = utils::hash::fnv1a(&modified, sizeof(modified), sourceHash);
+	sourceHash = utils::hash::fnv1a(settings, sizeof(settings), sourceHash);
+	sourceHash = utils::hash::fnv1a(&scale, sizeof(scale), sourceHash);
+
+	const std::string path = m_File + PROXY_EXTENSION;
+	if (loadProxy(path, sourceHash))
+		return true;
+
+	return createProxy(path, sourceHash, scale) && loadProxy(path, sourceHash);
+}
+
+bool VideoPlayer::createProxy(const std::string &path, uint64_t sourceHash, float scale)
+{
+	if (!m_Capture.isOpened())
+		return false;
+
+	DEBUG("Video: creating proxy \"%s\".", path.c_str());
+	utils::Timer timer;
+
+	// Written under a temporary name, so an interrupted run never leaves a proxy that looks valid.
+	const std::string tempPath = path + ".tmp";
+	std::ofstream file(tempPath.c_str(), std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		WARNING("Video: could not write proxy \"%s\".", tempPath.c_str());
+		return false;
+	}
+
+	ProxyHeader header = {PROXY_MAGIC, PROXY_VERSION, sourceHash, m_StartFrame, 0, 0, 0};
+	const std::vector<char> padding(PROXY_DATA_OFFSET, 0);
+	file.write(padding.data(), static_cast<std::streamsize>(padding.size()));
+
+	m_Capture.set(CV_CAP_PROP_POS_FRAMES, m_StartFrame);
+	cv::Mat frame, scaled;
+	for (int i = m_StartFrame; i < m_EndFrame && m_Capture.read(frame); i++)
+	{
+		if (header.FrameCount == 0)
+		{
+			header.Width = std::max(static_cast<int>(std::lround(frame.cols * scale)), 1);
+			header.Height = std::max(static_cast<int>(std::lround(frame.rows * scale)), 1);
+		}
+
+		if (frame.cols != header.Width || frame.rows != header.Height)
+			cv::resize(frame, scaled, cv::Size(header.Width, header.Height), 0.0, 0.0, cv::INTER_AREA);
+		else
+			frame.copyTo(scaled);
+
+		file.write(reinterpret_cast<const char *>(scaled.data), static_cast<std::streamsize>(scaled.total() * scaled.elemSize()));
+		header.FrameCount++;
+	}
+	m_Capture.set(CV_CAP_PROP_POS_FRAMES, 0);
+
+	file.seekp(0);
+	file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+	file.close();
+	if (!file || header.FrameCount == 0)
+	{
+		WARNING("Video: could not write proxy \"%s\".", tempPath.c_str());
+		std::remove(tempPath.c_str());
+		return false;
+	}
+
+	std::remove(path.c_str());
+	if (std::rename(tempPath.c_str(), path.c_str()) != 0)
+	{
+		WARNING("Video: could not move proxy to \"%s\".", path.c_str());
+		return false;
+	}
+
+	DEBUG("Video: proxy with %i frames of %ix%i created in %.1f s.", header.FrameCount, header.Width, header.Height, timer.elapsedMs() / 1000.0);
+	return true;
+}
+
+bool VideoPlayer::loadProxy(const std::string &path, uint64_t sourceHash)
+{
+	if (!m_Proxy.open(path) || m_Proxy.size() < PROXY_DATA_OFFSET)
+		return false;
+
+	std::memcpy(&m_ProxyHeader, m_Proxy.data(), sizeof(ProxyHeader));
+	const ProxyHeader &header = m_ProxyHeader;
+	m_ProxyFrameBytes = static_cast<size_t>(std::max(header.Width, 0)) * std::max(header.Height, 0) * 3;
+
+	const bool valid = header.Magic == PROXY_MAGIC && header.Version == PROXY_VERSION && header.SourceHash == sourceHash &&
+					   header.FrameCount > 0 && m_ProxyFrameBytes > 0 &&
+					   (m_Proxy.size() - PROXY_DATA_OFFSET) / m_ProxyFrameBytes >= static_cast<size_t>(header.FrameCount);
+	if (!valid)
+	{
+		DEBUG("Video: proxy \"%s\" is outdated.", path.c_str());
+		m_Proxy.close();
+		return false;
+	}
+
+	DEBUG("Video: playing from proxy \"%s\".", path.c_str());
+	return true;
 }
 
 void VideoPlayer::initialize()
@@ -57,10 +270,72 @@ void VideoPlayer::initialize()
 		m_EndFrame = m_FrameCount;
 }
 
+void VideoPlayer::createTexture()
+{
+	if (m_TexID)
+		glDeleteTextures(1, &m_TexID);
+
+	// Create OpenGL texture.
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_TexID);
+
+	// Set texture format.
+	glTextureStorage2D(m_TexID, 1, GL_RGB8, std::max(m_Crop.width, 1), std::max(m_Crop.height, 1));
+	glTextureParameteri(m_TexID, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(m_TexID, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+bool VideoPlayer::setCrop(int x, int y, int width, int height)
+{
+	const cv::Rect crop = cv::Rect(x, y, width, height) & cv::Rect(cv::Point(0, 0), m_FrameSize);
+	if (crop.area() == 0)
+	{
+		WARNING("Video: crop %ix%i at %i, %i is outside of the frame.", width, height, x, y);
+		return false;
+	}
+
+	if (crop != m_Crop)
+	{
+		m_Crop = crop;
+		createTexture();
+	}
+	return true;
+}
+
+void VideoPlayer::uploadImage(const cv::Mat &image, const void *pixels)
+{
+	// Frames of a different size only get the part of the crop they cover.
+	const cv::Rect crop = m_Crop & cv::Rect(cv::Point(0, 0), image.size());
+	if (crop.area() == 0)
+		return;
+
+	// Rows are read from inside the full frame, so only the cropped pixels are transferred.
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, static_cast<GLint>(image.step[0] / image.elemSize()));
+	glPixelStorei(GL_UNPACK_SKIP_PIXELS, crop.x);
+	glPixelStorei(GL_UNPACK_SKIP_ROWS, crop.y);
+	glTextureSubImage2D(m_TexID, 0, 0, 0, crop.width, crop.height, GL_BGR, GL_UNSIGNED_BYTE, pixels);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+	glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+}
+
 void VideoPlayer::reset()
 {
-	// Set the frame number on the video
-	m_Capture.set(CV_CAP_PROP_POS_FRAMES, 0);
+	// Proxy frames only cover the played range, so both modes restart at its first frame
+	seek(m_StartFrame);
+}
+
+void VideoPlayer::seek(int frame, int stride)
+{
+	// Only the decode thread touches the capture, it picks the new generation up before its next frame.
+	m_Request = packRequest(currentGeneration() + 1, std::max(std::min(stride, 0xFF), 1), std::max(frame, 0));
+	m_WaitAfterSeek = true;
+}
+
+uint32_t VideoPlayer::currentGeneration() const
+{
+	return requestGeneration(m_Request.load());
 }
 
 int VideoPlayer::getFrameCount() const
@@ -72,34 +347,241 @@ cv::Mat VideoPlayer::retrieveFrameFromIndex(size_t index)
 {
 	if (index >= m_FrameCount)
 		index %= m_FrameCount;
+	int target = static_cast<int>(index);
+
+	// The proxy only holds the played range.
+	if (m_Proxy.isOpen())
+	{
+		const int first = m_ProxyHeader.StartFrame, last = first + m_ProxyHeader.FrameCount - 1;
+		if (target < first || target > last)
+		{
+			WARNING("Video: frame %i is outside of the proxy range [%i, %i], clamping it.", target, first, last);
+			target = std::min(std::max(target, first), last);
+		}
+	}
+
+	if (const cv::Mat *cached = m_FrameCache.find(target))
+		return *cached;
+
+	// Frames a little after the last retrieved one are already decoded or on their way.
+	bool continueStream = m_RetrieveGeneration == currentGeneration() && target > m_LastRetrieved &&
+						  target - m_LastRetrieved <= MAX_FORWARD_DECODE;
+	m_LastRetrieved = target;
+	releaseUploadedFrame();
+
+	cv::Mat image;
+	while (true)
+	{
+		if (!continueStream)
+		{
+			seek(target, 1);
+			m_RetrieveGeneration = currentGeneration();
+		}
+
+		// Frames passed on the way are cached as well, ring slots are reused by the decoder so they are copied.
+		while (DecodedFrame *frame = nextFrame(true))
+		{
+			const int decoded = frame->Index;
+			if (decoded <= target)
+			{
+				cv::Mat copy = frame->Image.clone();
+				if (decoded == target)
+					image = copy;
+				m_FrameCache.insert(decoded, std::move(copy));
+			}
+			m_Frames.pop();
 
-	m_Capture.set(CV_CAP_PROP_POS_FRAMES, index);
-	return retrieveFrame();
+			if (decoded >= target)
+				break;
+		}
+
+		// Playback may already have taken the target out of the continued stream, seeking to it cannot miss.
+		if (!image.empty() || !continueStream)
+			return image;
+		continueStream = false;
+	}
 }
 
 // Retrieves a frame by the given lerp value between the start_frame and end_frame
 cv::Mat VideoPlayer::retrieveFrameFromLerp(double find)
 {
-	const auto index = find * static_cast<double>((m_EndFrame - m_StartFrame) + m_StartFrame);
-	m_Capture.set(CV_CAP_PROP_POS_FRAMES, index);
-	return retrieveFrame();
+	const auto index = m_StartFrame + find * static_cast<double>(m_EndFrame - m_StartFrame);
+	return retrieveFrameFromIndex(static_cast<size_t>(std::max(std::lround(index), 0l)));
 }
 
-// Returns a frame by index of the video
-cv::Mat VideoPlayer::retrieveFrame()
+// Decodes the frame shown next, the ones before it are skipped
+bool VideoPlayer::decodeFrame(cv::Mat &image, int position, int stride)
 {
-	// Get next frame.
-	m_Capture.grab();
+	// Proxy frames are stored raw, reading one is a single copy into the ring slot.
+	if (m_Proxy.isOpen())
+	{
+		const int index = position + stride - 1 - m_ProxyHeader.StartFrame;
+		if (index < 0 || index >= m_ProxyHeader.FrameCount)
+			return false;
+
+		image.create(m_ProxyHeader.Height, m_ProxyHeader.Width, CV_8UC3);
+		std::memcpy(image.data, m_Proxy.data() + PROXY_DATA_OFFSET + m_ProxyFrameBytes * index, m_ProxyFrameBytes);
+		return true;
+	}
 
-	// Retrieve the frame
-	cv::Mat frame;
-	m_Capture >> frame;
+	// Skip frames without converting them.
+	for (int i = 1; i < stride; i++)
+		if (!m_Capture.grab())
+			return false;
 
-	return frame;
+	// Decode and convert the frame into the preallocated image.
+	return m_Capture.read(image);
 }
 
-void VideoPlayer::uploadNextFrame()
+void VideoPlayer::seekCapture(int &position, int target)
 {
-	cv::Mat image = retrieveFrame();
-	glTextureSubImage2D(m_TexID, 0, 0, 0, image.cols, image.rows, GL_BGR, GL_UNSIGNED_BYTE, image.ptr());
-}
\ No newline at end of file
+	// Any proxy frame can be read directly.
+	if (m_Proxy.isOpen())
+	{
+		position = target;
+		return;
+	}
+
+	if (target >= position && target - position <= MAX_FORWARD_DECODE)
+	{
+		// Grabbing does not convert the frames, this is cheaper than going back to a keyframe.
+		while (position < target && m_Capture.grab())
+			position++;
+		return;
+	}
+
+	m_Capture.set(CV_CAP_PROP_POS_FRAMES, target);
+	position = target;
+}
+
+void VideoPlayer::decodeLoop()
+{
+	uint32_t generation = UINT32_MAX;
+	int stride = PLAYBACK_STRIDE;
+	// Index of the frame the capture decodes next.
+	int position = 0;
+	bool endOfStream = false;
+
+	while (m_Running)
+	{
+		// Apply the latest seek, frames of older generations are dropped by the consumer.
+		const uint64_t request = m_Request.load();
+		if (requestGeneration(request) != generation)
+		{
+			generation = requestGeneration(request);
+			stride = requestStride(request);
+			seekCapture(position, requestFrame(request));
+			endOfStream = false;
+		}
+
+		DecodedFrame *frame = endOfStream ? nullptr : m_Frames.beginWrite();
+		if (!frame)
+		{
+			// Ring is full or the video ended, nothing to do until playback or a seek catches up.
+			std::this_thread::sleep_for(std::chrono::milliseconds(2));
+			continue;
+		}
+
+		if (!decodeFrame(frame->Image, position, stride))
+		{
+			// The capture position is unknown now, the next seek has to set it.
+			position = INT_MAX;
+			endOfStream = true;
+			m_EndOfStream = generation;
+			continue;
+		}
+
+		frame->Generation = generation;
+		frame->Index = position + stride - 1;
+		position += stride;
+		m_Frames.endWrite();
+	}
+}
+
+VideoPlayer::DecodedFrame *VideoPlayer::nextFrame(bool wait)
+{
+	if (!m_Decoder.joinable())
+		return nullptr;
+
+	const uint32_t generation = currentGeneration();
+	while (true)
+	{
+		DecodedFrame *frame = m_Frames.front();
+		if (frame && frame->Generation != generation)
+		{
+			m_Frames.pop();
+			continue;
+		}
+
+		if (frame || !wait || m_EndOfStream == generation)
+			return frame;
+		std::this_thread::yield();
+	}
+}
+
+void VideoPlayer::releaseUploadedFrame()
+{
+	if (!m_UploadFence)
+		return;
+
+	// One video frame later the copy is normally done and this does not block.
+	GLenum result = glClientWaitSync(m_UploadFence, 0, 0);
+	while (result == GL_TIMEOUT_EXPIRED)
+		result = glClientWaitSync(m_UploadFence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+	glDeleteSync(m_UploadFence);
+	m_UploadFence = nullptr;
+	m_Frames.pop();
+
+	if (m_QueryPending)
+	{
+		GLuint64 gpuTime = 0;
+		glGetQueryObjectui64v(m_UploadQuery, GL_QUERY_RESULT, &gpuTime);
+		m_UploadStats.GpuMs = gpuTime / 1e6;
+		m_QueryPending = false;
+	}
+}
+
+bool VideoPlayer::uploadNextFrame()
+{
+	releaseUploadedFrame();
+
+	// Random access decodes every frame, playback continues after the last shown frame at its own stride.
+	if (requestStride(m_Request.load()) != PLAYBACK_STRIDE)
+		seek(m_LastUploaded >= 0 ? m_LastUploaded + 1 : m_StartFrame);
+
+	DecodedFrame *frame = nextFrame(m_WaitAfterSeek);
+	if (!frame)
+	{
+		if (!m_WaitAfterSeek && m_EndOfStream != currentGeneration())
+		{
+			DEBUG("Video decoder fell behind, showing the previous frame again");
+		}
+		return false;
+	}
+	m_WaitAfterSeek = false;
+	m_LastUploaded = frame->Index;
+
+	utils::Timer timer;
+	const cv::Mat &image = frame->Image;
+
+	// Frames of a different size than the first one were decoded into their own memory.
+	if (frame->Mapped && image.data == frame->Mapped)
+	{
+		// The texture is filled from the pixel buffer asynchronously, the slot is released next time.
+		glBeginQuery(GL_TIME_ELAPSED, m_UploadQuery);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_PixelBuffer);
+		uploadImage(image, reinterpret_cast<const void *>(frame->Offset));
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glEndQuery(GL_TIME_ELAPSED);
+		m_QueryPending = true;
+		m_UploadFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+	else
+	{
+		uploadImage(image, image.ptr());
+		m_Frames.pop();
+	}
+
+	m_UploadStats.SubmitMs = timer.elapsedMs();
+	return true;
+}
@@ -4,22 +4,48 @@
 #include <iostream>
 #include <opencv2/opencv.hpp>
 
+#include "utils/LruCache.h"
+#include "utils/MappedFile.h"
+#include "utils/SpscRing.h"
+
+#include <atomic>
+#include <cstdint>
 #include <string>
+#include <thread>
 
 class VideoPlayer
 {
   public:
-	VideoPlayer(const char *file_name, int start_frame = 0, int end_frame = -1);
+	/*
+	 * With proxy_scale > 0 the frame range is transcoded once into a raw proxy file next to the
+	 * video, with frames scaled by proxy_scale. Playback and seeks then only copy frames from it.
+	 */
+	VideoPlayer(const char *file_name, int start_frame = 0, int end_frame = -1, float proxy_scale = 0.0f);
 	~VideoPlayer();
 
+	VideoPlayer(const VideoPlayer &) = delete;
+	VideoPlayer &operator=(const VideoPlayer &) = delete;
+
+	/*
+	 * Returns exactly the requested frame. Recently retrieved frames come from a cache, frames a
+	 * short distance after the last retrieved one are decoded forward instead of seeking.
+	 * The returned image shares its pixels with the cache. Playback continues frame by frame
+	 * after a decoded frame until the next seek.
+	 */
 	cv::Mat retrieveFrameFromLerp(double find);
 	cv::Mat retrieveFrameFromIndex(size_t index);
 
 	/*
-	 * Resets video to its initial frame.
+	 * Resets video to the start frame given to the constructor.
 	 */
 	void reset();
 
+	/*
+	 * Makes the decode thread continue at given frame, frames decoded before are dropped.
+	 * Stride is the distance between decoded frames, playback shows every second frame.
+	 */
+	void seek(int frame, int stride = PLAYBACK_STRIDE);
+
 	/*
 	 * Get number of frames.
 	 */
@@ -30,17 +56,73 @@ class VideoPlayer
 	 */
 	int getFPS() const { return m_FPS; }
 
+	/*
+	 * Size of the decoded frames.
+	 */
+	int getFrameWidth() const { return m_FrameSize.width; }
+	int getFrameHeight() const { return m_FrameSize.height; }
+
+	/*
+	 * Only uploads given rectangle of every frame, the texture is resized to it.
+	 * The rectangle is clipped to the frame, returns false if nothing of it is left.
+	 */
+	bool setCrop(int x, int y, int width, int height);
+
 	/*
 	 * Returns OpenGL texture ID to which video is uploaded.
 	 */
 	GLuint getTextureID() const { return m_TexID; }
 
 	/*
-	 * Grabs next frame from video and uploads it to OpenGL texture.
+	 * Uploads the next decoded frame to the OpenGL texture. Only waits for the decoder right
+	 * after a seek, otherwise the previous frame stays visible if none is ready yet.
+	 * Returns false if no frame was uploaded.
 	 */
-	void uploadNextFrame();
+	bool uploadNextFrame();
+
+	struct UploadStats
+	{
+		double SubmitMs = 0.0; // Time the render thread spent issuing the last upload
+		double GpuMs = 0.0;	   // Time the GPU spent copying the last frame from the pixel buffer
+	};
+
+	/*
+	 * Returns timings of the latest upload, the GPU time lags one upload behind.
+	 */
+	const UploadStats &getUploadStats() const { return m_UploadStats; }
+
+	// OpenCV reports half the real frame rate of our video, so playback skips every other frame.
+	static constexpr int PLAYBACK_STRIDE = 2;
 
   private:
+	// Number of frames the decode thread can be ahead of playback.
+	static constexpr size_t FRAME_RING_SIZE = 8;
+	// Up to this many frames are decoded forward instead of seeking, which restarts at a keyframe.
+	static constexpr int MAX_FORWARD_DECODE = 32;
+	// Memory used for retrieved frames.
+	static constexpr size_t FRAME_CACHE_BYTES = 256 * 1024 * 1024;
+
+	struct ProxyHeader
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint64_t SourceHash;
+		int32_t StartFrame;
+		int32_t FrameCount;
+		int32_t Width;
+		int32_t Height;
+	};
+
+	struct DecodedFrame
+	{
+		cv::Mat Image;
+		uint32_t Generation = 0;
+		int Index = 0;
+		// Region of the pixel buffer the image is decoded into, nullptr without pixel buffer.
+		unsigned char *Mapped = nullptr;
+		GLintptr Offset = 0;
+	};
+
 	int m_Width, m_Height;
 	int m_StartFrame, m_EndFrame;
 	int m_FrameCount;
@@ -49,13 +131,105 @@ class VideoPlayer
 	cv::VideoCapture m_Capture;
 	GLuint m_TexID = 0;
 
+	// Raw BGR frames of the proxy, used instead of the capture while open.
+	utils::MappedFile m_Proxy;
+	ProxyHeader m_ProxyHeader = {};
+	size_t m_ProxyFrameBytes = 0;
+
+	cv::Size m_FrameSize;
+	// Part of the frame that is uploaded, the whole frame by default.
+	cv::Rect m_Crop;
+
+	// Frames go from the decode thread to the render thread through this ring.
+	utils::SpscRing<DecodedFrame, FRAME_RING_SIZE> m_Frames;
+	std::thread m_Decoder;
+	std::atomic<bool> m_Running{false};
+
+	// Latest seek as generation, stride and frame packed together, so they are always read together.
+	std::atomic<uint64_t> m_Request{0};
+	// Generation for which the decoder reached the end of the video.
+	std::atomic<uint32_t> m_EndOfStream{UINT32_MAX};
+	bool m_WaitAfterSeek = true;
+	// Index of the frame uploaded last, playback continues after it once random access is done.
+	int m_LastUploaded = -1;
+
+	// Retrieved frames by index, and the generation and last frame of the current random access stream.
+	utils::LruCache<int, cv::Mat> m_FrameCache;
+	uint32_t m_RetrieveGeneration = UINT32_MAX;
+	int m_LastRetrieved = -1;
+
+	// Persistently mapped pixel unpack buffer with one region per ring slot.
+	GLuint m_PixelBuffer = 0;
+	// Signaled once the GPU copied the frame at the front of the ring, which stays there until then.
+	GLsync m_UploadFence = nullptr;
+	GLuint m_UploadQuery = 0;
+	bool m_QueryPending = false;
+	UploadStats m_UploadStats;
+
 	/*
 	 * Initializes video stream from OpenCV.
 	 */
 	void initialize();
 
 	/*
-	 * Retrieves a frame from the video.
+	 * Generation of the latest seek, frames of other generations are stale.
+	 */
+	uint32_t currentGeneration() const;
+
+	/*
+	 * Decodes the frame stride - 1 frames after position into given image, reusing its memory.
+	 */
+	bool decodeFrame(cv::Mat &image, int position, int stride);
+
+	/*
+	 * Moves the capture from position to target, decoding forward if target is close ahead.
+	 */
+	void seekCapture(int &position, int target);
+
+	/*
+	 * Decode thread, fills the frame ring and handles seeks.
+	 */
+	void decodeLoop();
+
+	/*
+	 * Creates the pixel buffer and points the ring slots into it.
+	 * Returns false if persistent mapping is not supported, the slots then keep their own memory.
+	 */
+	bool initPixelBuffer(const cv::Mat &image);
+
+	/*
+	 * Opens the proxy of the video, transcoding it first if it is missing or outdated.
+	 */
+	bool openProxy(float scale);
+
+	/*
+	 * Writes every frame of the range scaled by scale into a raw proxy file.
+	 */
+	bool createProxy(const std::string &path, uint64_t sourceHash, float scale);
+
+	/*
+	 * Maps the proxy file if it was created from the current video and settings.
+	 */
+	bool loadProxy(const std::string &path, uint64_t sourceHash);
+
+	/*
+	 * (Re)creates the texture with the size of the crop rectangle.
+	 */
+	void createTexture();
+
+	/*
+	 * Uploads the crop rectangle of image, pixels is its address in client memory or the bound pixel buffer.
+	 */
+	void uploadImage(const cv::Mat &image, const void *pixels);
+
+	/*
+	 * Returns the next frame of the current generation without removing it from the ring.
+	 * Stale frames from before the last seek are dropped.
+	 */
+	DecodedFrame *nextFrame(bool wait);
+
+	/*
+	 * Hands the last uploaded frame back to the decoder once the GPU finished reading it.
 	 */
-	cv::Mat retrieveFrame();
+	void releaseUploadedFrame();
 };
\ No newline at end of file
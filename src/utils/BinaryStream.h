@@ -0,0 +1,174 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace utils
+{
+
+// Arrays start at multiples of this, so they can be used in place from a mapped file
+constexpr size_t BINARY_ARRAY_ALIGNMENT = 16;
+
+/**
+ * Serializes plain values, arrays and strings into a byte buffer
+ */
+class BinaryWriter
+{
+  public:
+	template <typename T>
+	void write(const T &value)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable types can be written");
+		append(&value, sizeof(T));
+	}
+
+	/**
+	 * Writes element count followed by the aligned elements
+	 */
+	template <typename T>
+	void writeArray(const T *data, size_t count)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable types can be written");
+		write<uint64_t>(count);
+		m_Buffer.resize((m_Buffer.size() + BINARY_ARRAY_ALIGNMENT - 1) / BINARY_ARRAY_ALIGNMENT * BINARY_ARRAY_ALIGNMENT, 0);
+		append(data, sizeof(T) * count);
+	}
+
+	template <typename T>
+	void writeArray(const std::vector<T> &data)
+	{
+		writeArray(data.data(), data.size());
+	}
+
+	void writeString(const std::string &value)
+	{
+		write<uint64_t>(value.size());
+		append(value.data(), value.size());
+	}
+
+	/**
+	 * Writes the buffer to given file
+	 * @return 	False if the file could not be written
+	 */
+	bool save(const std::string &path) const
+	{
+		std::ofstream file(path.c_str(), std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+			return false;
+
+		file.write(m_Buffer.data(), static_cast<std::streamsize>(m_Buffer.size()));
+		return static_cast<bool>(file);
+	}
+
+	const std::vector<char> &buffer() const { return m_Buffer; }
+
+  private:
+	void append(const void *data, size_t size)
+	{
+		const char *bytes = static_cast<const char *>(data);
+		m_Buffer.insert(m_Buffer.end(), bytes, bytes + size);
+	}
+
+	std::vector<char> m_Buffer;
+};
+
+/**
+ * Reads data written by BinaryWriter. Reading past the end puts the reader into a failed state
+ * in which every read returns zeroed values, so callers only need to check ok() once at the end.
+ */
+class BinaryReader
+{
+  public:
+	BinaryReader(const char *data, size_t size) : m_Data(data), m_Size(size) {}
+
+	template <typename T>
+	T read()
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable types can be read");
+		T value;
+		std::memset(&value, 0, sizeof(T));
+		if (const char *src = take(sizeof(T)))
+			std::memcpy(&value, src, sizeof(T));
+		return value;
+	}
+
+	/**
+	 * Returns pointer to an array inside the read data without copying it
+	 * @param count 	Receives element count
+	 */
+	template <typename T>
+	const T *viewArray(size_t &count)
+	{
+		count = static_cast<size_t>(read<uint64_t>());
+		m_Offset = (m_Offset + BINARY_ARRAY_ALIGNMENT - 1) / BINARY_ARRAY_ALIGNMENT * BINARY_ARRAY_ALIGNMENT;
+		if (m_Size / sizeof(T) < count)
+			m_Failed = true;
+
+		const T *data = reinterpret_cast<const T *>(take(sizeof(T) * count));
+		if (!data)
+			count = 0;
+		return data;
+	}
+
+	template <typename T>
+	void readArray(std::vector<T> &out)
+	{
+		size_t count = 0;
+		const T *data = viewArray<T>(count);
+		out.assign(data, data + count);
+	}
+
+	std::string readString()
+	{
+		const size_t size = static_cast<size_t>(read<uint64_t>());
+		const char *data = take(size);
+		return data ? std::string(data, size) : std::string();
+	}
+
+	/**
+	 * Reads an element count written as uint32_t. Fails and returns 0 if the rest of the data
+	 * cannot hold that many elements of at least minSize bytes each.
+	 */
+	uint32_t readCount(size_t minSize)
+	{
+		const uint32_t count = read<uint32_t>();
+		const size_t remaining = m_Offset <= m_Size ? m_Size - m_Offset : 0;
+		if (minSize > 0 && remaining / minSize < count)
+		{
+			m_Failed = true;
+			return 0;
+		}
+
+		return m_Failed ? 0 : count;
+	}
+
+	/**
+	 * Whether all reads so far stayed inside the data
+	 */
+	bool ok() const { return !m_Failed; }
+
+  private:
+	const char *take(size_t size)
+	{
+		if (m_Failed || m_Offset > m_Size || m_Size - m_Offset < size)
+		{
+			m_Failed = true;
+			return nullptr;
+		}
+
+		const char *data = m_Data + m_Offset;
+		m_Offset += size;
+		return data;
+	}
+
+	const char *m_Data;
+	size_t m_Size;
+	size_t m_Offset = 0;
+	bool m_Failed = false;
+};
+
+} // namespace utils
@@ -0,0 +1,68 @@
+#pragma once
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define UTILS_CPU_X86 1
+#ifdef _MSC_VER
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+#else
+#define UTILS_CPU_X86 0
+#endif
+
+/**
+ * Instruction set extensions of the running CPU, used to pick SIMD code paths at runtime
+ */
+namespace utils
+{
+namespace cpu
+{
+
+struct Features
+{
+	bool AVX2 = false;
+	bool FMA = false;
+};
+
+inline Features detectFeatures()
+{
+	Features Result;
+#if UTILS_CPU_X86
+#ifdef _MSC_VER
+	int Info[4];
+	__cpuid(Info, 0);
+	if (Info[0] < 7)
+		return Result;
+
+	// AVX state has to be enabled by the OS as well
+	__cpuid(Info, 1);
+	const bool HasOSXSAVE = (Info[2] & (1 << 27)) != 0;
+	if (!HasOSXSAVE || (_xgetbv(0) & 0x6) != 0x6)
+		return Result;
+
+	Result.FMA = (Info[2] & (1 << 12)) != 0;
+	__cpuidex(Info, 7, 0);
+	Result.AVX2 = (Info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	Result.AVX2 = __builtin_cpu_supports("avx2");
+	Result.FMA = __builtin_cpu_supports("fma");
+#endif
+#endif
+	return Result;
+}
+
+/**
+ * Features are only detected once
+ */
+inline const Features &getFeatures()
+{
+	static const Features Detected = detectFeatures();
+	return Detected;
+}
+
+inline bool hasAVX2() { return getFeatures().AVX2; }
+inline bool hasFMA() { return getFeatures().FMA; }
+
+} // namespace cpu
+} // namespace utils
@@ -1,9 +1,20 @@
 #pragma once
 
+#include <cstdint>
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
 #include <string>
 
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <climits>
+#endif
+
 /**
  * File helper functions
  */
@@ -33,5 +44,58 @@ static bool exists(const std::string &path)
 	return file.is_open();
 }
 
+/**
+ * Returns the absolute path without symbolic links and relative parts, or path itself if it does not exist
+ */
+static std::string canonical(const std::string &path)
+{
+#ifdef _WIN32
+	char resolved[_MAX_PATH];
+	if (_fullpath(resolved, path.c_str(), _MAX_PATH))
+		return resolved;
+#else
+	char resolved[PATH_MAX];
+	if (realpath(path.c_str(), resolved))
+		return resolved;
+#endif
+	return path;
+}
+
+/**
+ * Reads size and last modification time of a file without opening it
+ * @return 	False if the file does not exist
+ */
+static bool getInfo(const std::string &path, uint64_t &size, int64_t &modified)
+{
+#ifdef _WIN32
+	struct _stat64 info;
+	if (_stat64(path.c_str(), &info) != 0)
+		return false;
+#else
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0)
+		return false;
+#endif
+	size = static_cast<uint64_t>(info.st_size);
+	modified = static_cast<int64_t>(info.st_mtime);
+	return true;
+}
+
+/**
+ * Creates a single directory, returns true if it exists afterwards
+ */
+static bool createDirectory(const std::string &path)
+{
+#ifdef _WIN32
+	_mkdir(path.c_str());
+	struct _stat info;
+	return _stat(path.c_str(), &info) == 0 && (info.st_mode & _S_IFDIR);
+#else
+	mkdir(path.c_str(), 0755);
+	struct stat info;
+	return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+#endif
+}
+
 } // namespace file
 } // namespace utils
\ No newline at end of file
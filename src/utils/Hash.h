@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Hash functions
+ */
+namespace utils
+{
+namespace hash
+{
+
+constexpr uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+/**
+ * 64-bit FNV-1a hash of Size bytes, Seed allows hashing data in several parts
+ */
+inline uint64_t fnv1a(const void *Data, size_t Size, uint64_t Seed = FNV_OFFSET_BASIS)
+{
+	const unsigned char *Bytes = static_cast<const unsigned char *>(Data);
+	uint64_t Hash = Seed;
+	for (size_t i = 0; i < Size; i++)
+	{
+		Hash ^= Bytes[i];
+		Hash *= FNV_PRIME;
+	}
+
+	return Hash;
+}
+
+/**
+ * FNV-1a hash of a null terminated string, equal to fnv1a() over its characters.
+ * Usable in constant expressions, so names can be hashed at compile time.
+ */
+constexpr uint64_t fnv1aString(const char *Str, uint64_t Seed = FNV_OFFSET_BASIS)
+{
+	uint64_t Hash = Seed;
+	for (; *Str; ++Str)
+	{
+		Hash ^= static_cast<unsigned char>(*Str);
+		Hash *= FNV_PRIME;
+	}
+
+	return Hash;
+}
+
+} // namespace hash
+} // namespace utils
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+namespace utils
+{
+
+/**
+ * Map holding at most capacity values, inserting into a full cache evicts the least recently used one
+ */
+template <typename Key, typename Value>
+class LruCache
+{
+  public:
+	explicit LruCache(size_t capacity = 0) : m_Capacity(capacity) {}
+
+	/**
+	 * Changes the number of values kept, evicting the oldest ones if needed
+	 */
+	void setCapacity(size_t capacity)
+	{
+		m_Capacity = capacity;
+		evict();
+	}
+
+	/**
+	 * Returns the value of key and marks it as most recently used, nullptr if it is not cached
+	 */
+	Value *find(const Key &key)
+	{
+		const auto it = m_Index.find(key);
+		if (it == m_Index.end())
+			return nullptr;
+
+		m_Entries.splice(m_Entries.begin(), m_Entries, it->second);
+		return &it->second->second;
+	}
+
+	/**
+	 * Adds or replaces the value of key
+	 */
+	void insert(const Key &key, Value value)
+	{
+		if (Value *existing = find(key))
+		{
+			*existing = std::move(value);
+			return;
+		}
+
+		m_Entries.emplace_front(key, std::move(value));
+		m_Index[key] = m_Entries.begin();
+		evict();
+	}
+
+	void clear()
+	{
+		m_Entries.clear();
+		m_Index.clear();
+	}
+
+	size_t size() const { return m_Entries.size(); }
+
+  private:
+	void evict()
+	{
+		while (m_Entries.size() > m_Capacity)
+		{
+			m_Index.erase(m_Entries.back().first);
+			m_Entries.pop_back();
+		}
+	}
+
+	size_t m_Capacity;
+	std::list<std::pair<Key, Value>> m_Entries;
+	std::unordered_map<Key, typename std::list<std::pair<Key, Value>>::iterator> m_Index;
+};
+
+} // namespace utils
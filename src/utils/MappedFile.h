@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace utils
+{
+
+/**
+ * Read-only memory mapping of a whole file, unmapped when destroyed
+ */
+class MappedFile
+{
+  public:
+	MappedFile() = default;
+	explicit MappedFile(const std::string &path) { open(path); }
+	~MappedFile() { close(); }
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	/**
+	 * Maps given file, closing any previously mapped one
+	 * @param path 	File to map
+	 * @return 		False if the file does not exist or could not be mapped
+	 */
+	bool open(const std::string &path)
+	{
+		close();
+
+#ifdef _WIN32
+		m_File = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (m_File == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(m_File, &size) || size.QuadPart == 0)
+		{
+			close();
+			return false;
+		}
+
+		m_Mapping = CreateFileMappingA(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!m_Mapping)
+		{
+			close();
+			return false;
+		}
+
+		m_Data = static_cast<const char *>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+		m_Size = static_cast<size_t>(size.QuadPart);
+#else
+		const int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+
+		struct stat info;
+		if (fstat(fd, &info) != 0 || info.st_size == 0)
+		{
+			::close(fd);
+			return false;
+		}
+
+		void *data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		// The mapping stays valid after closing the descriptor
+		::close(fd);
+		if (data == MAP_FAILED)
+			return false;
+
+		m_Data = static_cast<const char *>(data);
+		m_Size = static_cast<size_t>(info.st_size);
+#endif
+
+		if (!m_Data)
+		{
+			close();
+			return false;
+		}
+
+		return true;
+	}
+
+	/**
+	 * Unmaps the file
+	 */
+	void close()
+	{
+#ifdef _WIN32
+		if (m_Data)
+			UnmapViewOfFile(m_Data);
+		if (m_Mapping)
+			CloseHandle(m_Mapping);
+		if (m_File != INVALID_HANDLE_VALUE)
+			CloseHandle(m_File);
+		m_Mapping = nullptr;
+		m_File = INVALID_HANDLE_VALUE;
+#else
+		if (m_Data)
+			munmap(const_cast<char *>(m_Data), m_Size);
+#endif
+		m_Data = nullptr;
+		m_Size = 0;
+	}
+
+	bool isOpen() const { return m_Data != nullptr; }
+	const char *data() const { return m_Data; }
+	size_t size() const { return m_Size; }
+
+  private:
+	const char *m_Data = nullptr;
+	size_t m_Size = 0;
+#ifdef _WIN32
+	HANDLE m_File = INVALID_HANDLE_VALUE;
+	HANDLE m_Mapping = nullptr;
+#endif
+};
+
+} // namespace utils
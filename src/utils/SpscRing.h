@@ -0,0 +1,64 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace utils
+{
+
+/**
+ * Fixed size lock-free queue for exactly one producer and one consumer thread.
+ * Elements stay in their slot and are reused, so they can own buffers that are filled in place.
+ */
+template <typename T, size_t Capacity>
+class SpscRing
+{
+	static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity has to be a power of two");
+
+  public:
+	/**
+	 * Producer: slot that the next element is written to, nullptr while the ring is full
+	 */
+	T *beginWrite()
+	{
+		const size_t head = m_Head.load(std::memory_order_relaxed);
+		if (head - m_Tail.load(std::memory_order_acquire) == Capacity)
+			return nullptr;
+		return &m_Slots[head & (Capacity - 1)];
+	}
+
+	/**
+	 * Producer: publishes the slot returned by beginWrite()
+	 */
+	void endWrite() { m_Head.store(m_Head.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+	/**
+	 * Consumer: oldest element, nullptr while the ring is empty
+	 */
+	T *front()
+	{
+		const size_t tail = m_Tail.load(std::memory_order_relaxed);
+		if (tail == m_Head.load(std::memory_order_acquire))
+			return nullptr;
+		return &m_Slots[tail & (Capacity - 1)];
+	}
+
+	/**
+	 * Consumer: hands the slot returned by front() back to the producer
+	 */
+	void pop() { m_Tail.store(m_Tail.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+	/**
+	 * All slots, only safe to touch before the producer and consumer start
+	 */
+	std::array<T, Capacity> &slots() { return m_Slots; }
+
+  private:
+	// Head and tail are written by different threads, keep them on separate cache lines
+	alignas(64) std::atomic<size_t> m_Head{0};
+	alignas(64) std::atomic<size_t> m_Tail{0};
+	std::array<T, Capacity> m_Slots;
+};
+
+} // namespace utils
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <chrono>
+
+/**
+ * Timing helpers; used for per-frame statistics
+ */
+namespace utils
+{
+
+class Timer
+{
+  public:
+	Timer() : m_Start(std::chrono::high_resolution_clock::now()) {}
+
+	/**
+	 * Restart timer from current time
+	 */
+	void reset() { m_Start = std::chrono::high_resolution_clock::now(); }
+
+	/**
+	 * Returns elapsed time since construction or last reset in milliseconds
+	 */
+	float elapsedMs() const
+	{
+		const auto now = std::chrono::high_resolution_clock::now();
+		return std::chrono::duration<float, std::milli>(now - m_Start).count();
+	}
+
+  private:
+	std::chrono::high_resolution_clock::time_point m_Start;
+};
+
+} // namespace utils
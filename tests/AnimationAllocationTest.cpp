@@ -0,0 +1,122 @@
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "TestUtils.h"
+
+#include "Model.h"
+
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+/*
+ * Runs the per-frame animation update of the demo, Model::transformBones followed by
+ * Model::getSkeletalRig, and checks that it makes no heap allocations once running.
+ * Needs an OpenGL context and the capture, the test is skipped if either is missing.
+ */
+
+// Exit code CTest reports as a skipped test
+constexpr int SKIP_TEST = 77;
+constexpr const char *CAPTURE_PATH = "Data/Capture/capture.DAE";
+constexpr int NUM_FRAMES = 600;
+
+// Allocations of the calling thread, skinning threads and background loading do not add to it
+static thread_local size_t AllocationCount = 0;
+
+void *operator new(size_t Size)
+{
+	AllocationCount++;
+	if (void *Ptr = std::malloc(Size ? Size : 1))
+		return Ptr;
+	throw std::bad_alloc();
+}
+
+void operator delete(void *Ptr) noexcept
+{
+	std::free(Ptr);
+}
+
+void operator delete(void *Ptr, size_t) noexcept
+{
+	std::free(Ptr);
+}
+
+// Animates the model frame by frame at 60 fps and returns the allocations of all frames but the first
+static size_t countAllocations(Model &Mesh, int RigRoot)
+{
+	std::vector<Model::RigBone> Rig;
+	size_t Allocations = 0;
+	for (int f = 0; f < NUM_FRAMES; f++)
+	{
+		const size_t Before = AllocationCount;
+		Mesh.transformBones(f / 60.0f);
+		Mesh.getSkeletalRig(RigRoot, Rig);
+
+		// The first frame may still grow the buffers
+		if (f > 0)
+			Allocations += AllocationCount - Before;
+	}
+	return Allocations;
+}
+
+int main()
+{
+	if (glfwInit() != GLFW_TRUE)
+	{
+		std::fprintf(stderr, "Skipped, could not init GLFW\n");
+		return SKIP_TEST;
+	}
+
+	// Same context as the demo window, but hidden
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef __APPLE__
+	glewExperimental = GL_TRUE;
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+	GLFWwindow *Window = glfwCreateWindow(64, 64, "AnimationAllocationTest", nullptr, nullptr);
+	if (!Window)
+	{
+		std::fprintf(stderr, "Skipped, could not create an OpenGL context\n");
+		glfwTerminate();
+		return SKIP_TEST;
+	}
+	glfwMakeContextCurrent(Window);
+
+	int Result = SKIP_TEST;
+	if (glewInit() != GLEW_NO_ERROR)
+	{
+		std::fprintf(stderr, "Skipped, could not init GLEW\n");
+	}
+	else
+	{
+		Model Mesh(true);
+		if (!Mesh.loadMesh(CAPTURE_PATH))
+		{
+			std::fprintf(stderr, "Skipped, could not load %s\n", CAPTURE_PATH);
+		}
+		else
+		{
+			const int RigRoot = Mesh.findNode("MiaFBXASC058Hips");
+			for (const Model::SkinningMode Mode : {Model::SkinningMode::CPU, Model::SkinningMode::GPU})
+			{
+				if (!Mesh.setSkinningMode(Mode))
+					continue;
+
+				const size_t Allocations = countAllocations(Mesh, RigRoot);
+				if (Allocations > 0)
+					std::fprintf(stderr, "%s skinning: %zu allocations in %d frames\n", Mode == Model::SkinningMode::CPU ? "CPU" : "GPU",
+								 Allocations, NUM_FRAMES - 1);
+				CHECK(Allocations == 0);
+			}
+			Result = TEST_RESULT();
+		}
+	}
+
+	glfwDestroyWindow(Window);
+	glfwTerminate();
+	return Result;
+}
@@ -0,0 +1,104 @@
+#include "TestUtils.h"
+
+#include "utils/BinaryStream.h"
+
+#include <string>
+#include <vector>
+
+// Values, arrays and strings read back as they were written
+static void testRoundTrip()
+{
+	utils::BinaryWriter Writer;
+	Writer.write<uint32_t>(42);
+	Writer.write<float>(1.5f);
+	Writer.writeArray(std::vector<uint16_t>{1, 2, 3});
+	Writer.writeString("bones");
+	Writer.write<uint32_t>(2);
+
+	const std::vector<char> &Data = Writer.buffer();
+	utils::BinaryReader Reader(Data.data(), Data.size());
+	CHECK(Reader.read<uint32_t>() == 42);
+	CHECK(Reader.read<float>() == 1.5f);
+
+	size_t Count = 0;
+	const uint16_t *Array = Reader.viewArray<uint16_t>(Count);
+	CHECK(Count == 3 && Array && Array[0] == 1 && Array[2] == 3);
+	CHECK(reinterpret_cast<uintptr_t>(Array) % utils::BINARY_ARRAY_ALIGNMENT == reinterpret_cast<uintptr_t>(Data.data()) % utils::BINARY_ARRAY_ALIGNMENT);
+
+	CHECK(Reader.readString() == "bones");
+	CHECK(Reader.readCount(0) == 2);
+	CHECK(Reader.ok());
+}
+
+// Reading past the end fails and returns zeroed values from then on
+static void testPastEnd()
+{
+	utils::BinaryWriter Writer;
+	Writer.write<uint16_t>(7);
+
+	const std::vector<char> &Data = Writer.buffer();
+	utils::BinaryReader Reader(Data.data(), Data.size());
+	CHECK(Reader.read<uint32_t>() == 0);
+	CHECK(!Reader.ok());
+	CHECK(Reader.read<uint8_t>() == 0);
+	CHECK(!Reader.ok());
+}
+
+// Counts larger than the remaining data are rejected before anything is allocated
+static void testCorruptCounts()
+{
+	// Array count that would overflow the byte size
+	{
+		utils::BinaryWriter Writer;
+		Writer.write<uint64_t>(UINT64_MAX / 2);
+		const std::vector<char> &Data = Writer.buffer();
+		utils::BinaryReader Reader(Data.data(), Data.size());
+		size_t Count = 1;
+		CHECK(Reader.viewArray<uint32_t>(Count) == nullptr);
+		CHECK(Count == 0);
+		CHECK(!Reader.ok());
+	}
+
+	// String longer than the data
+	{
+		utils::BinaryWriter Writer;
+		Writer.write<uint64_t>(1000);
+		Writer.write<uint32_t>(0);
+		const std::vector<char> &Data = Writer.buffer();
+		utils::BinaryReader Reader(Data.data(), Data.size());
+		CHECK(Reader.readString().empty());
+		CHECK(!Reader.ok());
+	}
+
+	// Element count that does not fit the rest of the data
+	{
+		utils::BinaryWriter Writer;
+		Writer.write<uint32_t>(3);
+		Writer.write<uint64_t>(0);
+		const std::vector<char> &Data = Writer.buffer();
+
+		utils::BinaryReader Fits(Data.data(), Data.size());
+		CHECK(Fits.readCount(2) == 3);
+		CHECK(Fits.ok());
+
+		utils::BinaryReader TooMany(Data.data(), Data.size());
+		CHECK(TooMany.readCount(4) == 0);
+		CHECK(!TooMany.ok());
+	}
+
+	// Count read from truncated data
+	{
+		const char Truncated[2] = {1, 0};
+		utils::BinaryReader Reader(Truncated, sizeof(Truncated));
+		CHECK(Reader.readCount(1) == 0);
+		CHECK(!Reader.ok());
+	}
+}
+
+int main()
+{
+	testRoundTrip();
+	testPastEnd();
+	testCorruptCounts();
+	return TEST_RESULT();
+}
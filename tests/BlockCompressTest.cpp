@@ -0,0 +1,226 @@
+#include "TestUtils.h"
+
+#include "BlockCompress.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// Lowest peak signal to noise ratio accepted for the color channels of a smooth image
+constexpr double MIN_COLOR_PSNR = 30.0;
+
+static void unpackRgb565(uint16_t Packed, int *Color)
+{
+	const int r = (Packed >> 11) & 31, g = (Packed >> 5) & 63, b = Packed & 31;
+	Color[0] = (r << 3) | (r >> 2);
+	Color[1] = (g << 2) | (g >> 4);
+	Color[2] = (b << 3) | (b >> 2);
+}
+
+// Decodes a BC1 color block the way the GPU does, including the three color mode
+static void decodeColor(const unsigned char *Block, unsigned char *Pixels)
+{
+	const uint16_t Color0 = static_cast<uint16_t>(Block[0] | (Block[1] << 8));
+	const uint16_t Color1 = static_cast<uint16_t>(Block[2] | (Block[3] << 8));
+
+	int Palette[4][3];
+	unpackRgb565(Color0, Palette[0]);
+	unpackRgb565(Color1, Palette[1]);
+	for (int c = 0; c < 3; c++)
+	{
+		if (Color0 > Color1)
+		{
+			Palette[2][c] = (2 * Palette[0][c] + Palette[1][c]) / 3;
+			Palette[3][c] = (Palette[0][c] + 2 * Palette[1][c]) / 3;
+		}
+		else
+		{
+			Palette[2][c] = (Palette[0][c] + Palette[1][c]) / 2;
+			Palette[3][c] = 0;
+		}
+	}
+
+	for (int i = 0; i < 16; i++)
+	{
+		const int Index = (Block[4 + i / 4] >> (2 * (i % 4))) & 3;
+		for (int c = 0; c < 3; c++)
+			Pixels[4 * i + c] = static_cast<unsigned char>(Palette[Index][c]);
+	}
+}
+
+// Decodes the alpha half of a BC3 block
+static void decodeAlpha(const unsigned char *Block, unsigned char *Pixels)
+{
+	const int Alpha0 = Block[0], Alpha1 = Block[1];
+	int Palette[8] = {Alpha0, Alpha1};
+	for (int p = 2; p < 8; p++)
+	{
+		if (Alpha0 > Alpha1)
+			Palette[p] = ((8 - p) * Alpha0 + (p - 1) * Alpha1) / 7;
+		else
+			Palette[p] = p < 6 ? ((6 - p) * Alpha0 + (p - 1) * Alpha1) / 5 : (p == 6 ? 0 : 255);
+	}
+
+	uint64_t Indices = 0;
+	for (int i = 0; i < 6; i++)
+		Indices |= static_cast<uint64_t>(Block[2 + i]) << (8 * i);
+	for (int i = 0; i < 16; i++)
+		Pixels[4 * i + 3] = static_cast<unsigned char>(Palette[(Indices >> (3 * i)) & 7]);
+}
+
+// Decodes the first level into RGBA pixels, alpha is 255 for BC1
+static std::vector<unsigned char> decodeLevel(const bcn::CompressedImage &Image)
+{
+	const bcn::MipLevel &Level = Image.Levels[0];
+	const unsigned int BlocksX = (Level.Width + 3) / 4, BlocksY = (Level.Height + 3) / 4;
+	const size_t BlockBytes = bcn::blockSize(Image.Encoding);
+
+	std::vector<unsigned char> Pixels(static_cast<size_t>(Level.Width) * Level.Height * 4);
+	for (unsigned int by = 0; by < BlocksY; by++)
+	{
+		for (unsigned int bx = 0; bx < BlocksX; bx++)
+		{
+			const unsigned char *Block = Image.Data.data() + Level.Offset + (static_cast<size_t>(by) * BlocksX + bx) * BlockBytes;
+			unsigned char Decoded[64];
+			std::memset(Decoded, 255, sizeof(Decoded));
+			if (Image.Encoding == bcn::Format::BC3)
+			{
+				decodeAlpha(Block, Decoded);
+				decodeColor(Block + 8, Decoded);
+			}
+			else
+				decodeColor(Block, Decoded);
+
+			// Blocks crossing the border are cut off
+			for (unsigned int y = 0; y < 4 && by * 4 + y < Level.Height; y++)
+			{
+				for (unsigned int x = 0; x < 4 && bx * 4 + x < Level.Width; x++)
+					std::memcpy(&Pixels[4 * ((by * 4 + y) * static_cast<size_t>(Level.Width) + bx * 4 + x)], Decoded + 4 * (y * 4 + x), 4);
+			}
+		}
+	}
+	return Pixels;
+}
+
+// Smooth color gradients with a diagonal alpha ramp, the slopes do not depend on the image size
+static std::vector<unsigned int> makeImage(unsigned int Width, unsigned int Height, bool Alpha)
+{
+	std::vector<unsigned int> Pixels(static_cast<size_t>(Width) * Height);
+	unsigned char *Bytes = reinterpret_cast<unsigned char *>(Pixels.data());
+	for (unsigned int y = 0; y < Height; y++)
+	{
+		for (unsigned int x = 0; x < Width; x++)
+		{
+			unsigned char *Pixel = Bytes + 4 * (static_cast<size_t>(y) * Width + x);
+			Pixel[0] = static_cast<unsigned char>(std::min(3 * x, 255u));
+			Pixel[1] = static_cast<unsigned char>(std::min(40 + 3 * y, 255u));
+			Pixel[2] = static_cast<unsigned char>(128 + 100 * std::sin(0.1 * (x + y)));
+			Pixel[3] = Alpha ? static_cast<unsigned char>(std::min(20 + 2 * (x + y), 255u)) : 255;
+		}
+	}
+	return Pixels;
+}
+
+// Compresses and decodes images of even and odd sizes, checking the mip chain and the error of the first level
+static void testRoundTrip(unsigned int Width, unsigned int Height, bcn::Format Encoding)
+{
+	const bool Alpha = Encoding == bcn::Format::BC3;
+	const std::vector<unsigned int> Source = makeImage(Width, Height, Alpha);
+	CHECK(bcn::hasAlpha(Source.data(), Source.size()) == Alpha);
+
+	bcn::CompressedImage Image;
+	bcn::compress(Source.data(), Width, Height, Encoding, Image);
+	CHECK(Image.Encoding == Encoding);
+	CHECK(Image.getWidth() == Width && Image.getHeight() == Height);
+
+	// Levels halve down to 1x1 and are packed back to back
+	uint64_t Offset = 0;
+	for (size_t i = 0; i < Image.Levels.size(); i++)
+	{
+		const bcn::MipLevel &Level = Image.Levels[i];
+		CHECK(Level.Width == std::max(Width >> i, 1u) && Level.Height == std::max(Height >> i, 1u));
+		CHECK(Level.Offset == Offset);
+		CHECK(Level.Size == ((Level.Width + 3) / 4) * ((Level.Height + 3) / 4) * bcn::blockSize(Encoding));
+		Offset += Level.Size;
+	}
+	CHECK(!Image.Levels.empty() && Image.Levels.back().Width == 1 && Image.Levels.back().Height == 1);
+	CHECK(Image.Data.size() == Offset);
+
+	const std::vector<unsigned char> Decoded = decodeLevel(Image);
+	const unsigned char *Original = reinterpret_cast<const unsigned char *>(Source.data());
+
+	double SquaredError = 0.0;
+	int MaxAlphaError = 0;
+	for (size_t i = 0; i < Source.size(); i++)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			const double d = Decoded[4 * i + c] - Original[4 * i + c];
+			SquaredError += d * d;
+		}
+		MaxAlphaError = std::max(MaxAlphaError, std::abs(Decoded[4 * i + 3] - Original[4 * i + 3]));
+	}
+
+	const double Mse = SquaredError / (3.0 * Source.size());
+	const double Psnr = Mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / Mse) : 100.0;
+	CHECK(Psnr >= MIN_COLOR_PSNR);
+
+	// Eight interpolated alpha values per block keep the error of a gentle ramp within a few steps
+	const int MaxAllowedAlphaError = Alpha ? 2 : 0;
+	CHECK(MaxAlphaError <= MaxAllowedAlphaError);
+	if (Psnr < MIN_COLOR_PSNR || MaxAlphaError > MaxAllowedAlphaError)
+		std::fprintf(stderr, "%ux%u %s: %.1f dB, alpha error %d\n", Width, Height, Alpha ? "BC3" : "BC1", Psnr, MaxAlphaError);
+}
+
+// Cooked files read back unchanged and are rejected for other sources or when damaged
+static void testSaveLoad()
+{
+	const char *Path = "BlockCompressTest.bcn";
+	const std::vector<unsigned int> Source = makeImage(20, 12, true);
+
+	bcn::CompressedImage Image;
+	bcn::compress(Source.data(), 20, 12, bcn::Format::BC3, Image);
+	CHECK(bcn::save(Path, 1234, Image));
+
+	bcn::CompressedImage Loaded;
+	CHECK(bcn::load(Path, 1234, Loaded));
+	CHECK(Loaded.Encoding == Image.Encoding);
+	CHECK(Loaded.Levels.size() == Image.Levels.size());
+	CHECK(Loaded.Data == Image.Data);
+	CHECK(!bcn::load(Path, 4321, Loaded));
+
+	// Cut off the last byte of the data
+	std::vector<char> Bytes;
+	if (std::FILE *File = std::fopen(Path, "rb"))
+	{
+		char Buffer[4096];
+		size_t Read;
+		while ((Read = std::fread(Buffer, 1, sizeof(Buffer), File)) > 0)
+			Bytes.insert(Bytes.end(), Buffer, Buffer + Read);
+		std::fclose(File);
+	}
+	CHECK(!Bytes.empty());
+	if (std::FILE *File = std::fopen(Path, "wb"))
+	{
+		std::fwrite(Bytes.data(), 1, Bytes.size() - 1, File);
+		std::fclose(File);
+	}
+	CHECK(!bcn::load(Path, 1234, Loaded));
+
+	std::remove(Path);
+	CHECK(!bcn::load(Path, 1234, Loaded));
+}
+
+int main()
+{
+	for (const bcn::Format Encoding : {bcn::Format::BC1, bcn::Format::BC3})
+	{
+		testRoundTrip(64, 48, Encoding);
+		testRoundTrip(13, 7, Encoding);
+		testRoundTrip(1, 1, Encoding);
+	}
+	testSaveLoad();
+	return TEST_RESULT();
+}
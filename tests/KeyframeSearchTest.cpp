@@ -0,0 +1,77 @@
+#include "TestUtils.h"
+
+#include "KeyframeSearch.h"
+
+#include <random>
+#include <vector>
+
+// Linear search the cursor replaced, the reference for every lookup
+static unsigned int findKeyframeLinear(float AnimationTime, const std::vector<float> &Times)
+{
+	for (unsigned int i = 0; i + 2 < Times.size(); i++)
+	{
+		if (AnimationTime < Times[i + 1])
+			return i;
+	}
+	return static_cast<unsigned int>(Times.size() - 2);
+}
+
+static std::vector<float> makeTimes(unsigned int NumKeys, std::mt19937 &Random)
+{
+	std::uniform_real_distribution<float> Step(0.1f, 2.0f);
+	std::vector<float> Times(NumKeys);
+	float Time = 0.0f;
+	for (float &t : Times)
+	{
+		t = Time;
+		Time += Step(Random);
+	}
+	return Times;
+}
+
+// Playback forward with small and large steps, including times before the first and after the last key
+static void testPlayback(unsigned int NumKeys, std::mt19937 &Random)
+{
+	const std::vector<float> Times = makeTimes(NumKeys, Random);
+	const auto keyTime = [&Times](unsigned int i) { return Times[i]; };
+
+	for (const float Step : {0.05f, 0.7f, 3.0f})
+	{
+		unsigned int Cursor = 0;
+		for (float t = Times.front() - 1.0f; t < Times.back() + 1.0f; t += Step)
+			CHECK(findKeyframe(t, NumKeys, Cursor, keyTime) == findKeyframeLinear(t, Times));
+	}
+}
+
+// Random seeks starting from whatever the cursor held before, including stale out of range cursors
+static void testSeeks(unsigned int NumKeys, std::mt19937 &Random)
+{
+	const std::vector<float> Times = makeTimes(NumKeys, Random);
+	const auto keyTime = [&Times](unsigned int i) { return Times[i]; };
+	std::uniform_real_distribution<float> Time(Times.front() - 1.0f, Times.back() + 1.0f);
+
+	unsigned int Cursor = NumKeys + 5;
+	for (int i = 0; i < 1000; i++)
+	{
+		const float t = Time(Random);
+		const unsigned int Index = findKeyframe(t, NumKeys, Cursor, keyTime);
+		CHECK(Index == findKeyframeLinear(t, Times));
+		CHECK(Cursor == Index);
+	}
+
+	// Exactly on a key the interval starting there is found
+	for (unsigned int i = 0; i + 1 < NumKeys; i++)
+		CHECK(findKeyframe(Times[i], NumKeys, Cursor, keyTime) == i);
+	CHECK(findKeyframe(Times.back(), NumKeys, Cursor, keyTime) == NumKeys - 2);
+}
+
+int main()
+{
+	std::mt19937 Random(1234);
+	for (const unsigned int NumKeys : {2u, 3u, 4u, 17u, 250u})
+	{
+		testPlayback(NumKeys, Random);
+		testSeeks(NumKeys, Random);
+	}
+	return TEST_RESULT();
+}
@@ -0,0 +1,69 @@
+#include "TestUtils.h"
+
+#include "utils/LruCache.h"
+
+#include <string>
+
+// Inserting into a full cache evicts the least recently used entry, a lookup refreshes an entry
+static void testEviction()
+{
+	utils::LruCache<int, std::string> Cache(2);
+	Cache.insert(1, "one");
+	Cache.insert(2, "two");
+	CHECK(Cache.size() == 2);
+
+	// Touch 1, so 2 is the oldest now
+	CHECK(Cache.find(1) != nullptr && *Cache.find(1) == "one");
+	Cache.insert(3, "three");
+	CHECK(Cache.size() == 2);
+	CHECK(Cache.find(2) == nullptr);
+	CHECK(Cache.find(1) != nullptr);
+	CHECK(Cache.find(3) != nullptr);
+}
+
+// Replacing a value neither grows the cache nor evicts another entry
+static void testReplace()
+{
+	utils::LruCache<int, std::string> Cache(2);
+	Cache.insert(1, "one");
+	Cache.insert(2, "two");
+	Cache.insert(1, "uno");
+	CHECK(Cache.size() == 2);
+	CHECK(Cache.find(1) != nullptr && *Cache.find(1) == "uno");
+	CHECK(Cache.find(2) != nullptr && *Cache.find(2) == "two");
+}
+
+// Shrinking evicts the oldest entries right away, a cache without capacity keeps nothing
+static void testCapacity()
+{
+	utils::LruCache<int, int> Cache(4);
+	for (int i = 0; i < 4; i++)
+		Cache.insert(i, i * 10);
+
+	Cache.setCapacity(2);
+	CHECK(Cache.size() == 2);
+	CHECK(Cache.find(0) == nullptr);
+	CHECK(Cache.find(1) == nullptr);
+	CHECK(Cache.find(2) != nullptr && *Cache.find(2) == 20);
+	CHECK(Cache.find(3) != nullptr && *Cache.find(3) == 30);
+
+	Cache.setCapacity(0);
+	CHECK(Cache.size() == 0);
+	Cache.insert(5, 50);
+	CHECK(Cache.size() == 0);
+	CHECK(Cache.find(5) == nullptr);
+
+	Cache.setCapacity(3);
+	Cache.insert(6, 60);
+	Cache.clear();
+	CHECK(Cache.size() == 0);
+	CHECK(Cache.find(6) == nullptr);
+}
+
+int main()
+{
+	testEviction();
+	testReplace();
+	testCapacity();
+	return TEST_RESULT();
+}
@@ -0,0 +1,210 @@
+#include "TestUtils.h"
+
+#include "Skinning.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+
+constexpr unsigned int NUM_BONES = 12;
+constexpr float TOLERANCE = 1e-4f;
+
+// Random mesh in which vertex v has v % 7 bone weights, so every influence count occurs and some vertices exceed the maximum
+static std::unique_ptr<aiMesh> makeMesh(unsigned int NumVertices, std::mt19937 &Random)
+{
+	std::uniform_real_distribution<float> Coordinate(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> Weight(0.05f, 1.0f);
+
+	std::unique_ptr<aiMesh> Mesh(new aiMesh());
+	Mesh->mNumVertices = NumVertices;
+	Mesh->mVertices = new aiVector3D[NumVertices];
+	Mesh->mNormals = new aiVector3D[NumVertices];
+	for (unsigned int v = 0; v < NumVertices; v++)
+	{
+		Mesh->mVertices[v] = aiVector3D(Coordinate(Random), Coordinate(Random), Coordinate(Random));
+		Mesh->mNormals[v] = aiVector3D(Coordinate(Random), Coordinate(Random), Coordinate(Random)).Normalize();
+	}
+
+	// Vertex v is influenced by bones v, v + 1, ... so every bone gets some vertices
+	std::vector<std::vector<aiVertexWeight>> BoneWeights(NUM_BONES);
+	for (unsigned int v = 0; v < NumVertices; v++)
+	{
+		for (unsigned int j = 0; j < v % 7; j++)
+			BoneWeights[(v + j) % NUM_BONES].push_back(aiVertexWeight(v, Weight(Random)));
+	}
+
+	Mesh->mNumBones = NUM_BONES;
+	Mesh->mBones = new aiBone *[NUM_BONES];
+	for (unsigned int b = 0; b < NUM_BONES; b++)
+	{
+		aiBone *Bone = new aiBone();
+		Bone->mNumWeights = static_cast<unsigned int>(BoneWeights[b].size());
+		Bone->mWeights = new aiVertexWeight[Bone->mNumWeights];
+		std::copy(BoneWeights[b].begin(), BoneWeights[b].end(), Bone->mWeights);
+		Mesh->mBones[b] = Bone;
+	}
+	return Mesh;
+}
+
+static std::vector<glm::mat4> makePalette(std::mt19937 &Random)
+{
+	std::uniform_real_distribution<float> Value(-1.0f, 1.0f);
+	std::vector<glm::mat4> Palette(NUM_BONES);
+	for (glm::mat4 &Bone : Palette)
+	{
+		Bone = glm::translate(glm::mat4(1.0f), glm::vec3(Value(Random), Value(Random), Value(Random)));
+		Bone = glm::rotate(Bone, Value(Random) * 3.0f, glm::normalize(glm::vec3(Value(Random), Value(Random), 1.0f)));
+		Bone = glm::scale(Bone, glm::vec3(1.0f + 0.5f * Value(Random)));
+	}
+	return Palette;
+}
+
+/*
+ * Straightforward skinning of the original vertex v: transforms the vertex by each of its
+ * strongest MAX_BONE_INFLUENCES bones separately and blends the results.
+ */
+static void skinReference(const aiMesh *Mesh, const std::vector<unsigned int> &MeshBones, const std::vector<glm::mat4> &Palette, unsigned int v,
+						  glm::vec3 &Position, glm::vec3 &Normal)
+{
+	std::vector<std::pair<float, unsigned int>> Influences;
+	for (unsigned int b = 0; b < Mesh->mNumBones; b++)
+	{
+		for (unsigned int i = 0; i < Mesh->mBones[b]->mNumWeights; i++)
+		{
+			if (Mesh->mBones[b]->mWeights[i].mVertexId == v)
+				Influences.emplace_back(Mesh->mBones[b]->mWeights[i].mWeight, MeshBones[b]);
+		}
+	}
+
+	const glm::vec3 RestPosition(Mesh->mVertices[v].x, Mesh->mVertices[v].y, Mesh->mVertices[v].z);
+	const glm::vec3 RestNormal(Mesh->mNormals[v].x, Mesh->mNormals[v].y, Mesh->mNormals[v].z);
+	if (Influences.empty())
+	{
+		Position = RestPosition;
+		Normal = RestNormal;
+		return;
+	}
+
+	std::sort(Influences.begin(), Influences.end(), [](const std::pair<float, unsigned int> &a, const std::pair<float, unsigned int> &b) { return a.first > b.first; });
+	Influences.resize(std::min<size_t>(Influences.size(), MAX_BONE_INFLUENCES));
+
+	float Total = 0.0f;
+	for (const auto &Influence : Influences)
+		Total += Influence.first;
+
+	Position = glm::vec3(0.0f);
+	Normal = glm::vec3(0.0f);
+	for (const auto &Influence : Influences)
+	{
+		const glm::mat4 &Bone = Palette[Influence.second];
+		Position += glm::vec3(Bone * glm::vec4(RestPosition, 1.0f)) * (Influence.first / Total);
+		Normal += glm::mat3(Bone) * RestNormal * (Influence.first / Total);
+	}
+}
+
+static bool isClose(const glm::vec3 &a, const glm::vec3 &b)
+{
+	const glm::vec3 Difference = glm::abs(a - b);
+	return std::max(Difference.x, std::max(Difference.y, Difference.z)) <= TOLERANCE * (1.0f + glm::length(b));
+}
+
+// Skins two meshes, one spanning several chunks, with different thread counts and compares every vertex to the reference
+static void testAgainstReference()
+{
+	std::mt19937 Random(42);
+	const std::vector<glm::mat4> Palette = makePalette(Random);
+
+	// The palette is shared, each mesh maps its bones to different palette entries
+	std::vector<unsigned int> MeshBones[2];
+	for (unsigned int b = 0; b < NUM_BONES; b++)
+	{
+		MeshBones[0].push_back(b);
+		MeshBones[1].push_back(NUM_BONES - 1 - b);
+	}
+
+	std::unique_ptr<aiMesh> Sources[2] = {makeMesh(37, Random), makeMesh(2 * SKINNING_CHUNK_SIZE + 123, Random)};
+	SkinnedMesh Skins[2];
+	std::vector<unsigned int> Orders[2];
+	for (unsigned int m = 0; m < 2; m++)
+	{
+		skinning::buildInfluences(Sources[m].get(), MeshBones[m], Skins[m], Orders[m]);
+		CHECK(Skins[m].NumVertices == Sources[m]->mNumVertices);
+		CHECK(Skins[m].InfluenceEnds[MAX_BONE_INFLUENCES] == Skins[m].NumVertices);
+
+		// Influence counts never decrease along the sorted vertices
+		for (unsigned int k = 1; k <= MAX_BONE_INFLUENCES; k++)
+			CHECK(Skins[m].InfluenceEnds[k - 1] <= Skins[m].InfluenceEnds[k]);
+	}
+
+	for (const unsigned int Threads : {1u, 3u})
+	{
+		skinning::setThreadCount(Threads);
+
+		std::vector<glm::vec3> Positions[2], Normals[2];
+		glm::vec3 *PositionPtrs[2], *NormalPtrs[2];
+		for (unsigned int m = 0; m < 2; m++)
+		{
+			Positions[m].assign(Skins[m].NumVertices, glm::vec3(NAN));
+			Normals[m].assign(Skins[m].NumVertices, glm::vec3(NAN));
+			PositionPtrs[m] = Positions[m].data();
+			NormalPtrs[m] = Normals[m].data();
+		}
+		skinning::skinMeshes(Skins, 2, Palette.data(), PositionPtrs, NormalPtrs);
+
+		for (unsigned int m = 0; m < 2; m++)
+		{
+			unsigned int Mismatches = 0;
+			for (unsigned int n = 0; n < Skins[m].NumVertices; n++)
+			{
+				glm::vec3 Position, Normal;
+				skinReference(Sources[m].get(), MeshBones[m], Palette, Orders[m][n], Position, Normal);
+				if (!isClose(Positions[m][n], Position) || !isClose(Normals[m][n], Normal))
+					Mismatches++;
+			}
+			CHECK(Mismatches == 0);
+		}
+	}
+	skinning::setThreadCount(0);
+}
+
+// A serialized skin reads back unchanged, truncated data is rejected
+static void testSerialization()
+{
+	std::mt19937 Random(7);
+	std::unique_ptr<aiMesh> Source = makeMesh(100, Random);
+	std::vector<unsigned int> MeshBones(NUM_BONES), Order;
+	for (unsigned int b = 0; b < NUM_BONES; b++)
+		MeshBones[b] = b;
+
+	SkinnedMesh Skin;
+	skinning::buildInfluences(Source.get(), MeshBones, Skin, Order);
+
+	utils::BinaryWriter Writer;
+	Skin.write(Writer);
+	const std::vector<char> &Data = Writer.buffer();
+
+	SkinnedMesh Loaded;
+	utils::BinaryReader Reader(Data.data(), Data.size());
+	CHECK(Loaded.read(Reader));
+	CHECK(Loaded.NumVertices == Skin.NumVertices);
+	CHECK(std::equal(Skin.InfluenceEnds, Skin.InfluenceEnds + MAX_BONE_INFLUENCES + 1, Loaded.InfluenceEnds));
+	CHECK(Loaded.RestPositions == Skin.RestPositions);
+	CHECK(Loaded.BoneIds == Skin.BoneIds);
+	CHECK(Loaded.Weights == Skin.Weights);
+
+	SkinnedMesh Truncated;
+	utils::BinaryReader Short(Data.data(), Data.size() - 1);
+	CHECK(!Truncated.read(Short));
+}
+
+int main()
+{
+	testAgainstReference();
+	testSerialization();
+	return TEST_RESULT();
+}
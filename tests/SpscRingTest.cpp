@@ -0,0 +1,76 @@
+#include "TestUtils.h"
+
+#include "utils/SpscRing.h"
+
+#include <thread>
+
+// Fills and drains the ring on one thread, checking the full and empty states and FIFO order
+static void testSingleThread()
+{
+	utils::SpscRing<int, 4> Ring;
+	CHECK(Ring.front() == nullptr);
+
+	for (int i = 0; i < 4; i++)
+	{
+		int *Slot = Ring.beginWrite();
+		CHECK(Slot != nullptr);
+		if (Slot)
+			*Slot = i;
+		Ring.endWrite();
+	}
+	CHECK(Ring.beginWrite() == nullptr);
+
+	for (int i = 0; i < 4; i++)
+	{
+		const int *Front = Ring.front();
+		CHECK(Front != nullptr && *Front == i);
+		Ring.pop();
+	}
+	CHECK(Ring.front() == nullptr);
+	CHECK(Ring.beginWrite() != nullptr);
+}
+
+// One producer and one consumer thread, every element has to arrive exactly once and in order
+static void testTwoThreads()
+{
+	constexpr int COUNT = 200000;
+	utils::SpscRing<int, 8> Ring;
+
+	std::thread Producer([&Ring]() {
+		for (int i = 0; i < COUNT; i++)
+		{
+			int *Slot;
+			while (!(Slot = Ring.beginWrite()))
+				std::this_thread::yield();
+			*Slot = i;
+			Ring.endWrite();
+		}
+	});
+
+	int Expected = 0;
+	bool InOrder = true;
+	while (Expected < COUNT)
+	{
+		const int *Front = Ring.front();
+		if (!Front)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		InOrder = InOrder && *Front == Expected;
+		Expected++;
+		Ring.pop();
+	}
+	Producer.join();
+
+	CHECK(InOrder);
+	CHECK(Ring.front() == nullptr);
+}
+
+int main()
+{
+	testSingleThread();
+	testTwoThreads();
+	return TEST_RESULT();
+}
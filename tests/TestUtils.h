@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+
+/**
+ * Minimal checks for the unit tests. A failed check is reported and counted, the test keeps
+ * running so one run shows every failure. main() returns TEST_RESULT().
+ */
+namespace test
+{
+
+inline int &failures()
+{
+	static int count = 0;
+	return count;
+}
+
+} // namespace test
+
+#define CHECK(condition)                                                                 \
+	do                                                                                   \
+	{                                                                                    \
+		if (!(condition))                                                                \
+		{                                                                                \
+			std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+			test::failures()++;                                                          \
+		}                                                                                \
+	} while (0)
+
+#define TEST_RESULT() (test::failures() == 0 ? EXIT_SUCCESS : EXIT_FAILURE)